@@ -11,50 +11,22 @@
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QTextStream>
-#include <QtCore/QTimer>
 
 #include <QRemoteSignal>
 
 #include "printservice.h"
 
-#define CLEANUP_INTERVAL 1000 //ms
-
 Server::Server (QObject *parent):QObject(parent) {
-   mTcpSrv = new QTcpServer(this);
-   connect(mTcpSrv,SIGNAL(newConnection()),
-           this,SLOT(newConnection()));
-   mTcpSrv->listen(QHostAddress::Any,8081);
-   QTimer* cleanupTimer = new QTimer(this);
-   connect(cleanupTimer,SIGNAL(timeout()),
-           this,SLOT(cleanPool()));
-   cleanupTimer->start(CLEANUP_INTERVAL);
-
    mManager = new qrs::ServicesManager(this);
    qrs::PrintService* print_service = new qrs::PrintService(mManager);
    connect(print_service,SIGNAL(print(QString)),
            this,SLOT(print(const QString&)));
    connect(print_service,SIGNAL(quit()),
            qApp,SLOT(quit()));
-}
-
-void Server::newConnection() {
-   QTcpSocket* socket = mTcpSrv->nextPendingConnection();
-   if (socket == 0) return;
-   mManager->addDevice(socket);
-   mConnectionPool.append(socket);
-}
 
-void Server::cleanPool() {
-   if ( mConnectionPool.isEmpty() ) return;
-   QLinkedList<QTcpSocket*>::iterator indx = mConnectionPool.begin();
-   while ( indx != mConnectionPool.end() ) {
-      if ( ! (*indx)->isOpen() ) {
-         delete *indx;
-         indx = mConnectionPool.erase(indx);
-         continue;
-      }
-      indx++;
-   }
+   // Server deletes closed connections by itself
+   mServer = new qrs::ServicesServer(mManager,this);
+   mServer->listen(QHostAddress::Any,8081);
 }
 
 void Server::print(const QString& line) {
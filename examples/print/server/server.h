@@ -9,9 +9,6 @@
 #define Server_h
 
 #include <QtCore/QObject>
-#include <QtCore/QLinkedList>
-#include <QtNetwork/QTcpSocket>
-#include <QtNetwork/QTcpServer>
 
 #include <QRemoteSignal>
 
@@ -21,13 +18,10 @@ class Server : public QObject {
       Server(QObject *parent = 0);
       ~Server() {};
    public slots:
-      void newConnection();
-      void cleanPool();
       void print(const QString& line);
    private:
-      QTcpServer* mTcpSrv;
-      QLinkedList<QTcpSocket*> mConnectionPool;
       qrs::ServicesManager* mManager;
+      qrs::ServicesServer* mServer;
 };
 
 #endif
@@ -9,6 +9,7 @@
 #define _AbsMessageSerializer_H
 
 #include <memory>
+#include <cstring>
 
 #include <QtCore/QObject>
 #include <QtCore/QByteArray>
@@ -16,6 +17,7 @@
 #include "qrsexport.h"
 #include "message.h"
 #include "serializationexceptions.h"
+#include "status.h"
 
 namespace qrs {
 
@@ -105,6 +107,50 @@ namespace qrs {
              */
             int version() const {return mVersion;}
 
+            /**
+             * @brief Identifier of the wire format used in protocol
+             * negotiation.
+             *
+             * Two serializers having the same non empty identifier should
+             * produce raw messages which can be read by each other. Default
+             * implementation returns empty array which means this
+             * serializer can't be selected during the negotiation.
+             *
+             * @sa ServicesManager::setSupportedSerializers
+             */
+            virtual QByteArray protocolId() const {return QByteArray();}
+
+            /**
+             * @brief Check if raw message looks like one written by this
+             * serializer.
+             *
+             * Only a few first bytes should be checked so the check is much
+             * cheaper then deserialization. Default implementation returns
+             * false which means this serializer can't be selected by
+             * CompositeSerializer.
+             *
+             * @sa CompositeSerializer
+             */
+            virtual bool recognizes(const QByteArray &msg) const {
+                Q_UNUSED(msg);
+                return false;
+            }
+
+            /**
+             * @brief Serializer which should be used to deserialize the raw
+             * message.
+             *
+             * ServicesManager uses the serializer returned to deserialize
+             * the message and to serialize replies to the device it came
+             * from. Default implementation returns this serializer.
+             * CompositeSerializer returns the serializer which recognizes
+             * the message.
+             */
+            virtual AbsMessageSerializer *select(const QByteArray &msg) {
+                Q_UNUSED(msg);
+                return this;
+            }
+
             /**
              * @brief Serealize Message
              *
@@ -122,6 +168,35 @@ namespace qrs {
              */
             virtual QByteArray serialize(const Message& msg)
                 throw(UnsupportedTypeException) = 0;
+            /**
+             * @brief Serealize Message leaving room before it
+             *
+             * ServicesManager uses this function to write the frame size
+             * field and the message into the same array which is sent to
+             * the device with one write.
+             *
+             * Default implementation copies the result of serialize(). Reimplement
+             * it if your serializer can write the message at the offset
+             * directly.
+             *
+             * @throw UnsupportedTypeException same as serialize()
+             *
+             * @param msg Message class instance to be converted to a underlying
+             * protocol message.
+             * @param offset number of bytes with unspecified values preceding
+             * the raw message in the array returned.
+             *
+             * @return raw underlying protocol message preceded by @a offset
+             * bytes.
+             */
+            virtual QByteArray serializeAt(const Message& msg, int offset)
+                throw(UnsupportedTypeException) {
+                const QByteArray raw = serialize(msg);
+                QByteArray res;
+                res.resize(offset + raw.size());
+                std::memcpy(res.data() + offset, raw.constData(), raw.size());
+                return res;
+            }
             /**
              * @brief Deserealize Message
              *
@@ -138,6 +213,28 @@ namespace qrs {
             virtual MessageAP deserialize(const QByteArray& msg)
                 throw(MessageParsingException) = 0;
 
+            /**
+             * @brief Deserealize Message without throwing exceptions
+             *
+             * ServicesManager uses this function for the incoming messages
+             * so malformed input doesn't cost exception unwinding and error
+             * description formatting. @a status is changed only if error
+             * occurs.
+             *
+             * Default implementation calls the throwing version. Reimplement
+             * it if your serializer can report errors without exceptions.
+             *
+             * @return Message class instance or null pointer in case of error
+             */
+            virtual MessageAP deserialize(const QByteArray& msg, Status &status) {
+                try {
+                    return deserialize(msg);
+                } catch (const MessageParsingException &e) {
+                    status = Status(e.mErrorType, e.reason());
+                }
+                return MessageAP();
+            }
+
         private:
             /**
              * @brief Serializer version.
@@ -13,6 +13,14 @@
 
 using namespace qrs;
 
+void AbsService::processMessage(const Message& msg, Status &status) {
+    try {
+        processMessage(msg);
+    } catch ( IncorrectMethodException& e ) {
+        status = Status(Message::IncorrectMethod, e.reason());
+    }
+}
+
 bool AbsService::autoconnect(QObject *target) {
     const QMetaObject *serviceMetaObject = this->metaObject();
     const QMetaObject *targetMetaObject = target->metaObject();
@@ -14,6 +14,7 @@
 #include "qrsexport.h"
 #include "baseexception.h"
 #include "message.h"
+#include "status.h"
 
 namespace qrs {
 
@@ -53,6 +54,25 @@ namespace qrs {
           */
          virtual void processMessage(const Message& msg)
                throw(IncorrectMethodException) = 0;
+
+         /**
+          * @brief Process message reporting errors with status code.
+          *
+          * ServicesManager calls this function instead of the throwing one.
+          * @a status is changed only if message can't be processed. Classes
+          * generated by qrsc reimplement it without exceptions while default
+          * implementation calls the throwing version.
+          */
+         virtual void processMessage(const Message& msg, Status &status);
+         /**
+          * @brief Emit batch signals with the calls collected so far.
+          *
+          * Called by ServicesManager when all the messages received from
+          * a device at once are processed. Classes generated by qrsc for
+          * interfaces with @b batch methods reimplement it. Default
+          * implementation does nothing.
+          */
+         virtual void flushBatches() {}
          /**
           * @brief Unique service name.
           *
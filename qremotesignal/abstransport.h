@@ -0,0 +1,64 @@
+/**
+ * @file abstransport.h
+ * @brief AbsTransport class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _AbsTransport_H
+#define _AbsTransport_H
+
+#include "qrsexport.h"
+
+namespace qrs {
+
+   /**
+    * @brief Abstract interface of the frame protection layer.
+    *
+    * Transport is set for a device with ServicesManager::addDevice(QIODevice *,
+    * AbsTransport *) and transforms every message frame on the way to and
+    * from the device. It works directly on the buffers owned by the device
+    * manager: seal() writes the protected frame right into the output buffer
+    * after the frame size field and open() restores the message in place of
+    * the frame received, so protection costs no extra copies of the frame.
+    *
+    * Control frames (pings, pongs, protocol negotiation) are sent as is.
+    *
+    * Each device needs its own transport instance since transports usually
+    * keep per connection state like message counters. Transport is used only
+    * from the thread of the ServicesManager it's added to.
+    *
+    * Transport sees message frames only and can't exchange anything with
+    * the peer before the first message. Encrypting transport built on it
+    * can't tell a fresh session from the recorded one replayed by an
+    * attacker, so recorded calls would be executed again.
+    *
+    * Stream oriented protection like TLS doesn't need this interface: pass
+    * QSslSocket to ServicesManager::addDevice(QIODevice *) instead.
+    */
+   class QRS_EXPORT AbsTransport {
+      public:
+         virtual ~AbsTransport() {}
+
+         /// @brief Number of bytes seal() adds to each message
+         virtual int overhead() const = 0;
+         /**
+          * Protects @a size bytes of the message @a data writing the result
+          * to @a out which has room for @a size + overhead() bytes.
+          *
+          * @return false if the message can't be protected.
+          */
+         virtual bool seal(const char *data, int size, char *out) = 0;
+         /**
+          * Checks and unprotects @a size bytes of the @a frame written by
+          * seal() on the other side. The message is written at the beginning
+          * of the @a frame buffer.
+          *
+          * @return message size or -1 if the frame is damaged or forged.
+          */
+         virtual int open(char *frame, int size) = 0;
+   };
+
+}
+
+#endif
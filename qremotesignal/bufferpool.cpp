@@ -0,0 +1,99 @@
+/**
+ * @file bufferpool.cpp
+ * @brief BufferPool class implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "bufferpool.h"
+
+#include <QtCore/QThreadStorage>
+
+using namespace qrs::internals;
+
+namespace {
+    /// Qt4 QThreadStorage holds pointers only
+    QThreadStorage<BufferPool*> pools;
+}
+
+BufferPool::BufferPool()
+{
+}
+
+BufferPool *BufferPool::local()
+{
+    if (!pools.hasLocalData()) {
+        pools.setLocalData(new BufferPool);
+    }
+    return pools.localData();
+}
+
+/// Index of the smallest class able to hold size bytes or -1
+int BufferPool::classIndex(int size)
+{
+    if (size > MAX_CLASS) {
+        return -1;
+    }
+    int res = 0;
+    for (int capacity = MIN_CLASS; capacity < size; capacity <<= 1) {
+        res++;
+    }
+    return res;
+}
+
+/**
+ * @brief Returns array of @a size bytes with undefined content
+ *
+ * Array is taken from the pool if there is one of the right size class.
+ * Otherwise new one with capacity of the class is allocated so it can be
+ * recycled later.
+ */
+QByteArray BufferPool::acquire(int size)
+{
+    const int index = classIndex(size);
+    QByteArray res;
+    if (index < 0) {
+        mStats.misses++;
+        res.resize(size);
+        return res;
+    }
+    QList<QByteArray> &free = mFree[index];
+    if (free.isEmpty()) {
+        mStats.misses++;
+        res.reserve(MIN_CLASS << index);
+    } else {
+        mStats.hits++;
+        res = free.takeLast();
+        mStats.cachedBuffers--;
+        mStats.cachedBytes -= res.capacity();
+    }
+    res.resize(size);
+    return res;
+}
+
+/**
+ * @brief Gives the array back to the pool
+ *
+ * Array is recycled if this is the last reference to its data and its
+ * capacity is one of the size classes. @a buf is null after the call
+ * anyway.
+ */
+void BufferPool::release(QByteArray &buf)
+{
+    if (buf.isNull()) {
+        return;
+    }
+    const int capacity = buf.capacity();
+    const int index = classIndex(capacity);
+    if (!buf.isDetached() || index < 0 || (MIN_CLASS << index) != capacity ||
+        mFree[index].size() >= MAX_FREE) {
+        mStats.dropped++;
+        buf = QByteArray();
+        return;
+    }
+    mFree[index].append(buf);
+    buf = QByteArray();
+    mStats.recycled++;
+    mStats.cachedBuffers++;
+    mStats.cachedBytes += capacity;
+}
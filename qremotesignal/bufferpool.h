@@ -0,0 +1,70 @@
+/**
+ * @file bufferpool.h
+ * @brief BufferPool class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _BufferPool_H
+#define _BufferPool_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+
+#include "bufferpoolstats.h"
+
+namespace qrs {
+namespace internals {
+
+/**
+ * @internal
+ *
+ * Per thread pool of the byte arrays used to read frames and to serialize
+ * messages. Arrays are grouped into power of two size classes from
+ * MIN_CLASS to MAX_CLASS bytes. Each array in the pool has capacity of its
+ * class exactly so resizing it to any size of the class doesn't reallocate.
+ * The only exception is Qt4 which shrinks array resized to less than half
+ * of its capacity so arrays much smaller than MIN_CLASS may miss the pool.
+ *
+ * Array given back with release() is recycled only if nobody else holds a
+ * reference to its data. Message keeping raw data (see
+ * Message::setRawParams) or queued datagram just makes the array dropped so
+ * reuse is never visible outside of the pool.
+ *
+ * The pool is not thread safe. Use local() to get the pool of the calling
+ * thread.
+ */
+class BufferPool {
+Q_DISABLE_COPY(BufferPool);
+public:
+    BufferPool();
+
+    /// @brief Pool of the calling thread
+    static BufferPool *local();
+
+    QByteArray acquire(int size);
+    void release(QByteArray &buf);
+
+    const BufferPoolStats &stats() const {return mStats;}
+
+    /// @brief Smallest size class
+    static const int MIN_CLASS = 64;
+    /// @brief Biggest size class. Bigger arrays are never pooled.
+    static const int MAX_CLASS = 256*1024;
+    /// @brief Number of size classes
+    static const int CLASSES = 13;
+    /// @brief Maximum number of arrays kept per size class
+    static const int MAX_FREE = 8;
+
+private:
+    static int classIndex(int size);
+
+    /// Free arrays by size class index
+    QList<QByteArray> mFree[CLASSES];
+    BufferPoolStats mStats;
+};
+
+} // namespace internals
+} // namespace qrs
+
+#endif
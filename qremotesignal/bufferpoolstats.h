@@ -0,0 +1,42 @@
+/**
+ * @file bufferpoolstats.h
+ * @brief BufferPoolStats structure
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _BufferPoolStats_H
+#define _BufferPoolStats_H
+
+#include <QtCore/QtGlobal>
+
+#include "qrsexport.h"
+
+namespace qrs {
+
+   /**
+    * @brief Counters of the per thread pool of the message buffers.
+    *
+    * @sa ServicesManager::bufferPoolStats()
+    */
+   struct QRS_EXPORT BufferPoolStats {
+      BufferPoolStats(): hits(0), misses(0), recycled(0), dropped(0),
+                         cachedBuffers(0), cachedBytes(0) {}
+
+      /// Buffers taken from the pool
+      quint64 hits;
+      /// Buffers allocated since the pool had no buffer of the size needed
+      quint64 misses;
+      /// Buffers returned to the pool
+      quint64 recycled;
+      /// Buffers freed since they were still in use or the pool was full
+      quint64 dropped;
+      /// Buffers waiting in the pool
+      int cachedBuffers;
+      /// Memory held by the buffers waiting in the pool
+      qint64 cachedBytes;
+   };
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * @file compositeserializer.cpp
+ * @brief CompositeSerializer implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "compositeserializer.h"
+
+#include "jsonserializer.h"
+#include "qdatastreamserializer.h"
+
+using namespace qrs;
+
+CompositeSerializer::CompositeSerializer(QObject *parent):
+      AbsMessageSerializer(parent) {
+   setDefaults();
+}
+
+CompositeSerializer::CompositeSerializer(int version, QObject *parent):
+      AbsMessageSerializer(version, parent) {
+   setDefaults();
+}
+
+void CompositeSerializer::setDefaults() {
+   mSerializers << qDataStreamSerializer_4_5 << jsonSerializer;
+}
+
+/**
+ * First serializer in the list is used for the devices which peer format is
+ * not known yet. Serializers which don't reimplement
+ * AbsMessageSerializer::recognizes() can still be used this way.
+ */
+void CompositeSerializer::setSerializers(const QList<AbsMessageSerializer*> &val) {
+   mSerializers = val;
+}
+
+AbsMessageSerializer *CompositeSerializer::select(const QByteArray &msg) {
+   foreach (AbsMessageSerializer *serializer, mSerializers) {
+      if ( serializer->recognizes(msg) ) {
+         return serializer;
+      }
+   }
+   return 0;
+}
+
+bool CompositeSerializer::recognizes(const QByteArray &msg) const {
+   foreach (AbsMessageSerializer *serializer, mSerializers) {
+      if ( serializer->recognizes(msg) ) {
+         return true;
+      }
+   }
+   return false;
+}
+
+QByteArray CompositeSerializer::serialize(const Message &msg)
+      throw(UnsupportedTypeException) {
+   if ( mSerializers.isEmpty() ) {
+      throw UnsupportedTypeException(QObject::tr("No serializers to select from"));
+   }
+   return mSerializers.first()->serialize(msg);
+}
+
+QByteArray CompositeSerializer::serializeAt(const Message &msg, int offset)
+      throw(UnsupportedTypeException) {
+   if ( mSerializers.isEmpty() ) {
+      throw UnsupportedTypeException(QObject::tr("No serializers to select from"));
+   }
+   return mSerializers.first()->serializeAt(msg, offset);
+}
+
+MessageAP CompositeSerializer::deserialize(const QByteArray &msg)
+      throw(MessageParsingException) {
+   Status status;
+   MessageAP res = deserialize(msg, status);
+   if ( !status.isOk() ) {
+      MessageParsingException err(status.detail(), status.code());
+      throw( err );
+   }
+   return res;
+}
+
+MessageAP CompositeSerializer::deserialize(const QByteArray &msg,
+                                           Status &status) {
+   AbsMessageSerializer *serializer = select(msg);
+   if ( serializer == 0 ) {
+      status = Status(Message::ProtocolError,
+                      QT_TRANSLATE_NOOP("QObject", "Unknown message format"));
+      return MessageAP();
+   }
+   return serializer->deserialize(msg, status);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file compositeserializer.h
+ * @brief CompositeSerializer class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _CompositeSerializer_H
+#define _CompositeSerializer_H
+
+#include <QtCore/QList>
+
+#include "qrsexport.h"
+#include "absmessageserializer.h"
+#include "globalserializer.h"
+
+namespace qrs {
+
+   /**
+    * @brief Serializer selecting wire format by the first bytes of a message.
+    *
+    * This serializer lets one ServicesManager talk to peers using different
+    * wire formats without protocol negotiation. Each incoming message is
+    * passed to the first serializer which AbsMessageSerializer::recognizes()
+    * it. Replies and signals are sent to the device in the format the peer
+    * used in its last message. Devices which haven't sent anything yet get
+    * messages in the format of the first serializer.
+    *
+    * By default the list contains qDataStreamSerializer_4_5 and
+    * jsonSerializer so a JSON peer is detected by the leading '{' and a
+    * QDataStream peer by the message type byte:
+    * @code
+    * manager->setSerializer(compositeSerializer);
+    * @endcode
+    *
+    * @note Change serializers list only before the serializer is used. It's
+    * not protected from concurrent access.
+    */
+   class QRS_EXPORT CompositeSerializer: public AbsMessageSerializer {
+      public:
+         explicit CompositeSerializer(QObject *parent = 0);
+         explicit CompositeSerializer(int version, QObject *parent = 0);
+         virtual ~CompositeSerializer() {}
+
+         /// @brief Serializers to select from in the order of preference
+         void setSerializers(const QList<AbsMessageSerializer*> &val);
+         /// @brief Serializers to select from in the order of preference
+         QList<AbsMessageSerializer*> serializers() const {return mSerializers;}
+
+         /// @brief Serializer recognizing the message or 0
+         virtual AbsMessageSerializer *select(const QByteArray &msg);
+         /// @brief Some of the serializers recognizes the message
+         virtual bool recognizes(const QByteArray &msg) const;
+
+         /// @brief Serializes with the first serializer
+         virtual QByteArray serialize(const Message &msg)
+               throw(UnsupportedTypeException);
+         /// @brief Serializes with the first serializer
+         virtual QByteArray serializeAt(const Message &msg, int offset)
+               throw(UnsupportedTypeException);
+         /// @copydoc AbsMessageSerializer::deserialize
+         virtual MessageAP deserialize(const QByteArray &msg)
+               throw(MessageParsingException);
+         /// @copydoc AbsMessageSerializer::deserialize(const QByteArray&,Status&)
+         virtual MessageAP deserialize(const QByteArray &msg, Status &status);
+
+      private:
+         Q_DISABLE_COPY(CompositeSerializer);
+
+         void setDefaults();
+
+         QList<AbsMessageSerializer*> mSerializers;
+   };
+
+}
+
+/**
+ * Pointer to single global instance of CompositeSerializer class with the
+ * default list of serializers.
+ */
+#define compositeSerializer qrs::GlobalSerializer<qrs::CompositeSerializer>::instance()
+
+#endif
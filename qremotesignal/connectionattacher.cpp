@@ -0,0 +1,49 @@
+/**
+ * @file connectionattacher.cpp
+ * @brief ConnectionAttacher implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "connectionattacher.h"
+
+#include <QtNetwork/QTcpSocket>
+
+using namespace qrs;
+using namespace qrs::internals;
+
+/**
+ * Creates attacher and moves it to the thread of the manager given.
+ */
+ConnectionAttacher::ConnectionAttacher(ServicesManager *manager):
+        QObject(0),
+        mManager(manager),
+        mConnections(0)
+{
+    moveToThread(manager->thread());
+}
+
+/**
+ * Creates socket for the descriptor given and adds it to the manager. Place
+ * for the connection should be already reserved with reserve() function.
+ */
+void ConnectionAttacher::attach(int socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    connect(socket, SIGNAL(destroyed()),
+            this, SLOT(onSocketDestroyed()));
+    if (!socket->setSocketDescriptor(socketDescriptor) || mManager == 0) {
+        delete socket;
+        return;
+    }
+    // Closed sockets are reclaimed immediately. ServicesManager removes
+    // deleted devices by itself.
+    connect(socket, SIGNAL(disconnected()),
+            socket, SLOT(deleteLater()));
+    mManager->addDevice(socket);
+}
+
+void ConnectionAttacher::onSocketDestroyed()
+{
+    mConnections.deref();
+}
@@ -0,0 +1,57 @@
+/**
+ * @file connectionattacher.h
+ * @brief ConnectionAttacher class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _ConnectionAttacher_H
+#define _ConnectionAttacher_H
+
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QAtomicInt>
+
+#include "servicesmanager.h"
+
+namespace qrs {
+namespace internals {
+
+/**
+ * @internal
+ *
+ * Helper object living in the thread of a ServicesManager used by
+ * ServicesServer. It creates sockets for accepted socket descriptors in the
+ * manager thread, adds them to the manager and deletes them as soon as they
+ * are disconnected.
+ *
+ * Number of live connections is stored in the atomic counter so it can be
+ * read from the server thread.
+ */
+class ConnectionAttacher : public QObject {
+Q_OBJECT
+Q_DISABLE_COPY(ConnectionAttacher);
+public:
+    explicit ConnectionAttacher(ServicesManager *manager);
+
+    ServicesManager *manager() {return mManager;}
+    /// @brief Number of sockets created and not yet deleted.
+    int connectionsCount() const {return mConnections.fetchAndAddRelaxed(0);}
+    /// @brief Reserve place for the connection which is going to be attached.
+    void reserve() {mConnections.ref();}
+
+public slots:
+    void attach(int socketDescriptor);
+
+private slots:
+    void onSocketDestroyed();
+
+private:
+    QPointer<ServicesManager> mManager;
+    mutable QAtomicInt mConnections;
+};
+
+} // namespace internals
+} // namespace qrs
+
+#endif
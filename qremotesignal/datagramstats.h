@@ -0,0 +1,47 @@
+/**
+ * @file datagramstats.h
+ * @brief DatagramStats structure
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _DatagramStats_H
+#define _DatagramStats_H
+
+#include <QtCore/QtGlobal>
+
+#include "qrsexport.h"
+
+namespace qrs {
+
+   /**
+    * @brief Counters of the datagram device (QUdpSocket).
+    *
+    * @sa ServicesManager::datagramStats(QIODevice *)
+    */
+   struct QRS_EXPORT DatagramStats {
+      DatagramStats(): datagramsSent(0), datagramsReceived(0),
+                       messagesSent(0), messagesReceived(0),
+                       bytesSent(0), bytesReceived(0),
+                       largestSent(0), largestReceived(0),
+                       sendDropped(0), receiveDropped(0) {}
+
+      quint64 datagramsSent;
+      quint64 datagramsReceived;
+      quint64 messagesSent;
+      quint64 messagesReceived;
+      quint64 bytesSent;
+      quint64 bytesReceived;
+      /// Size of the largest datagram sent
+      int largestSent;
+      /// Size of the largest datagram received
+      int largestReceived;
+      /// Messages bigger than the datagram size or failed to be written
+      quint64 sendDropped;
+      /// Malformed or unreadable datagrams and messages bigger than the size limit
+      quint64 receiveDropped;
+   };
+
+}
+
+#endif
@@ -7,15 +7,22 @@
  */
 #include "devicemanager.h"
 
+#include <cstring>
+
+#include <QtCore/QtEndian>
+#include <QtNetwork/QUdpSocket>
+
+#include "bufferpool.h"
+#include "keepalivewheel.h"
+#include "readscheduler.h"
+
 using namespace qrs;
 using namespace qrs::internals;
 
 DeviceManager::DeviceManager(QObject *parent):
         QObject(parent)
 {
-    mMaxMessageSize = 0;
-    mExpectedMessageSize = 0;
-    mDevice = 0;
+    init();
 }
 
 /**
@@ -30,11 +37,147 @@ DeviceManager::DeviceManager(QObject *parent):
  */
 DeviceManager::DeviceManager(QIODevice *device, QObject *parent = 0):
         QObject(parent)
+{
+    init();
+    this->setDevice(device);
+}
+
+/// Member initialization shared by the constructors
+void DeviceManager::init()
 {
     mMaxMessageSize = 0;
     mExpectedMessageSize = 0;
     mDevice = 0;
-    this->setDevice(device);
+    mKeepAliveInterval = 0;
+    mKeepAliveTimeout = 0;
+    mWheel = 0;
+    mLastReceived = 0;
+    mLastSent = 0;
+    mPongRequested = false;
+    mPendingControlFrame = 0;
+    mPauseOnLimit = false;
+    // Timers are children so they follow the manager to other thread
+    mResumeTimer.setParent(this);
+    mResumeTimer.setSingleShot(true);
+    connect(&mResumeTimer, SIGNAL(timeout()),
+            this, SLOT(onResume()));
+    mReadBudgetFrames = 0;
+    mReadBudgetBytes = 0;
+    mScheduler = 0;
+    mPassMessages = 0;
+    mDatagram = false;
+    mDatagramSize = DEFAULT_DATAGRAM_SIZE;
+    mOutgoingSize = 0;
+    mFlushTimer.setParent(this);
+    mFlushTimer.setSingleShot(true);
+    connect(&mFlushTimer, SIGNAL(timeout()),
+            this, SLOT(flushDatagram()));
+    mTransport = 0;
+    mTxChannel = 0;
+    mRxChannel = 0;
+}
+
+DeviceManager::~DeviceManager()
+{
+    if (mWheel != 0) {
+        mWheel->cancel(this);
+    }
+    if (mScheduler != 0) {
+        mScheduler->cancel(this);
+    }
+    delete mTransport;
+}
+
+/**
+ * Keep-alive wheel and read scheduler belong to the thread so the manager
+ * leaves them before it is moved to other thread and joins the ones of the
+ * new thread once it gets there.
+ */
+bool DeviceManager::event(QEvent *e)
+{
+    if (e->type() == QEvent::ThreadChange) {
+        const bool reading = mScheduler != 0 && mScheduler->isScheduled(this);
+        if (mWheel != 0) {
+            mWheel->cancel(this);
+            mWheel = 0;
+        }
+        if (mScheduler != 0) {
+            mScheduler->cancel(this);
+            mScheduler = 0;
+        }
+        // Posted events are moved to the new thread with the manager
+        QMetaObject::invokeMethod(this, "onThreadChanged", Qt::QueuedConnection,
+                                  Q_ARG(bool, reading));
+    }
+    return QObject::event(e);
+}
+
+/**
+ * Restores keep-alive and reading interrupted by the thread change.
+ */
+void DeviceManager::onThreadChanged(bool reading)
+{
+    if (mKeepAliveInterval > 0 || mKeepAliveTimeout > 0) {
+        setKeepAlive(mKeepAliveInterval, mKeepAliveTimeout);
+    }
+    if (reading) {
+        continueReading();
+    }
+}
+
+/**
+ * @brief Sets frame protection layer.
+ *
+ * Messages sent are passed to AbsTransport::seal() and frames received to
+ * AbsTransport::open() before they are delivered with the received signal.
+ * Control frames are not protected. Manager takes ownership of the
+ * @a transport deleting the previous one. Pass 0 to send messages as is.
+ *
+ * @sa transportError
+ */
+void DeviceManager::setTransport(AbsTransport *transport)
+{
+    if (transport == mTransport) {
+        return;
+    }
+    delete mTransport;
+    mTransport = transport;
+}
+
+int DeviceManager::transportOverhead() const
+{
+    return mTransport != 0 ? mTransport->overhead() : 0;
+}
+
+/**
+ * Unprotects frame received in place.
+ *
+ * @return false if the transport rejected the frame.
+ */
+bool DeviceManager::openFrame(QByteArray &frame)
+{
+    if (mTransport == 0) {
+        return true;
+    }
+    int size = mTransport->open(frame.data(), frame.size());
+    if (size < 0) {
+        return false;
+    }
+    frame.resize(size);
+    return true;
+}
+
+/**
+ * Writes protected message to @a out which has room for the message and
+ * the transport overhead.
+ */
+bool DeviceManager::sealFrame(const QByteArray &msg, char *out)
+{
+    if (mTransport->seal(msg.constData(), msg.size(), out)) {
+        return true;
+    }
+    emit transportError(this);
+    return false;
 }
 
 /**
@@ -60,15 +203,34 @@ void DeviceManager::setDevice(QIODevice* device)
         disconnect(mDevice,SIGNAL(destroyed( QObject* )),
                    this,SIGNAL(deviceUnavailable()));
     }
+    if (mScheduler != 0) {
+        mScheduler->cancel(this);
+    }
+    // Messages queued for the previous device are not sent to the new one
+    mFlushTimer.stop();
+    mOutgoing.clear();
+    mOutgoingSize = 0;
     mDevice = device;
+    mDatagram = qobject_cast<QUdpSocket*>(device) != 0;
     mExpectedMessageSize = 0;
+    mPendingControlFrame = 0;
+    mTxChannel = 0;
+    mRxChannel = 0;
     mBuffer.clear();
     mStream.setDevice(mDevice);
     mStream.setByteOrder(QDataStream::BigEndian);
     if (mDevice == 0) {
+        if (mWheel != 0) {
+            mWheel->cancel(this);
+        }
         emit deviceUnavailable();
         return;
     }
+    if (mWheel != 0) {
+        // Give the new device full timeout to show that it's alive
+        mLastReceived = mLastSent = mWheel->now();
+        scheduleKeepAlive();
+    }
     if (!device->isOpen() || !device->isReadable() || !device->isWritable()) {
        emit deviceUnavailable();
     }
@@ -78,7 +240,11 @@ void DeviceManager::setDevice(QIODevice* device)
             this,SIGNAL(deviceUnavailable()));
     connect(mDevice,SIGNAL(destroyed( QObject* )),
             this,SIGNAL(deviceUnavailable()));
-    if (mDevice->bytesAvailable() != 0) {
+    if (mDatagram) {
+        if (static_cast<QUdpSocket*>(mDevice)->hasPendingDatagrams()) {
+            onNewData();
+        }
+    } else if (mDevice->bytesAvailable() != 0) {
         onNewData();
     }
 }
@@ -94,6 +260,19 @@ void DeviceManager::setDevice(QIODevice* device)
  * @sa deviceUnavailable
  */
 void DeviceManager::send(const QByteArray& msg)
+{
+    send(msg, 0);
+}
+
+/**
+ * @brief Sends message to the logical channel
+ *
+ * ChannelFrame is written before the message only if the previous frame
+ * was sent to other channel. Datagram devices ignore channels.
+ *
+ * @sa receiveChannel
+ */
+void DeviceManager::send(const QByteArray &msg, int channel)
 {
     if (mDevice == 0) {
         emit deviceUnavailable();
@@ -106,7 +285,235 @@ void DeviceManager::send(const QByteArray& msg)
     if (msg.isNull()) {
         return;
     }
-    mStream << msg;
+    if (mDatagram) {
+        sendDatagram(msg);
+        return;
+    }
+    selectChannel(channel);
+    // Size field and message go with one write
+    if (mTransport != 0) {
+        const int size = msg.size() + mTransport->overhead();
+        mSendBuffer.resize(FRAME_HEADER + size);
+        qToBigEndian<quint32>(size, reinterpret_cast<uchar*>(mSendBuffer.data()));
+        if (!sealFrame(msg, mSendBuffer.data() + FRAME_HEADER)) {
+            return;
+        }
+    } else {
+        mSendBuffer.resize(FRAME_HEADER + msg.size());
+        qToBigEndian<quint32>(msg.size(), reinterpret_cast<uchar*>(mSendBuffer.data()));
+        std::memcpy(mSendBuffer.data() + FRAME_HEADER, msg.constData(), msg.size());
+    }
+    mDevice->write(mSendBuffer);
+    if (mWheel != 0) {
+        mLastSent = mWheel->now();
+    }
+}
+
+/**
+ * @brief Sends message already prefixed with its size
+ *
+ * @a frame starts with FRAME_HEADER bytes of the big endian message size
+ * followed by the message so plain stream device gets it with one write
+ * without copying. Message is cut out of the frame for the devices with
+ * transport and datagram devices.
+ *
+ * @sa AbsMessageSerializer::serializeAt
+ */
+void DeviceManager::sendFrame(const QByteArray &frame, int channel)
+{
+    if (mDatagram) {
+        // Queued datagram keeps a reference to the message
+        send(frame.mid(FRAME_HEADER), channel);
+        return;
+    }
+    if (mTransport != 0) {
+        send(QByteArray::fromRawData(frame.constData() + FRAME_HEADER,
+                                     frame.size() - FRAME_HEADER), channel);
+        return;
+    }
+    if (mDevice == 0 || !mDevice->isWritable()) {
+        emit deviceUnavailable();
+        return;
+    }
+    selectChannel(channel);
+    mDevice->write(frame);
+    if (mWheel != 0) {
+        mLastSent = mWheel->now();
+    }
+}
+
+/**
+ * @brief Sends control frame.
+ *
+ * Control frame is just a reserved value of the frame size field so it costs
+ * only four bytes. Nothing is sent if device is not writable.
+ *
+ * @sa ControlFrame
+ */
+void DeviceManager::sendControlFrame(ControlFrame frame)
+{
+    if (mDevice == 0 || !mDevice->isWritable()) {
+        return;
+    }
+    if (mDatagram) {
+        // Messages sent before the frame are delivered before it
+        flushDatagram();
+        uchar datagram[sizeof(quint32)];
+        qToBigEndian<quint32>(frame, datagram);
+        writeDatagram(QByteArray(reinterpret_cast<const char*>(datagram),
+                                 sizeof(datagram)), 0);
+        return;
+    }
+    mStream << quint32(frame);
+    if (mWheel != 0) {
+        mLastSent = mWheel->now();
+    }
+}
+
+/**
+ * @brief Sends control frame followed by the payload frame.
+ *
+ * Frame is delivered to the peer in the context of the @a channel.
+ *
+ * @sa controlFrameReceived
+ */
+void DeviceManager::sendControlFrame(ControlFrame frame,
+                                     const QByteArray &payload, int channel)
+{
+    if (mDevice == 0 || !mDevice->isWritable()) {
+        return;
+    }
+    if (mDatagram) {
+        // Payload is the rest of the datagram
+        flushDatagram();
+        QByteArray datagram;
+        datagram.resize(sizeof(quint32) + payload.size());
+        qToBigEndian<quint32>(frame, reinterpret_cast<uchar*>(datagram.data()));
+        std::memcpy(datagram.data() + sizeof(quint32), payload.constData(),
+                    payload.size());
+        writeDatagram(datagram, 0);
+        return;
+    }
+    selectChannel(channel);
+    // Null payload would be written as a ping frame by QDataStream
+    mStream << quint32(frame) << quint32(payload.size());
+    mStream.writeRawData(payload.constData(), payload.size());
+    if (mWheel != 0) {
+        mLastSent = mWheel->now();
+    }
+}
+
+bool DeviceManager::hasPayload(quint32 frame)
+{
+    return frame == HelloFrame;
+}
+
+/// Writes ChannelFrame if the previous frame was sent to other channel
+void DeviceManager::selectChannel(int channel)
+{
+    if (channel == mTxChannel) {
+        return;
+    }
+    mStream << quint32(ChannelFrame + channel);
+    mTxChannel = channel;
+}
+
+/**
+ * @brief Enables or disables keep-alive for the device.
+ *
+ * @param interval if nothing was sent to the device during this number of
+ * milliseconds ping control frame is sent. Device manager on the other side
+ * replies with pong frame so both sides see some activity on the connection.
+ * Value 0 disables pings.
+ * @param timeout if nothing was received from the device during this number
+ * of milliseconds peerTimeout signal is emitted. Value 0 disables dead peer
+ * detection.
+ *
+ * All device managers of one thread share single timer wheel with resolution
+ * of KeepAliveWheel::TICK_INTERVAL milliseconds so both intervals are rounded
+ * up to the wheel resolution.
+ *
+ * @note Peer replies with pong only if it uses QRemoteSignal 1.4.0 or newer.
+ * Don't set timeout for connections with older peers unless they send
+ * messages often enough.
+ *
+ * @sa peerTimeout
+ */
+void DeviceManager::setKeepAlive(int interval, int timeout)
+{
+    mKeepAliveInterval = qMax(interval, 0);
+    mKeepAliveTimeout = qMax(timeout, 0);
+    if (mKeepAliveInterval == 0 && mKeepAliveTimeout == 0) {
+        if (mWheel != 0) {
+            mWheel->cancel(this);
+            mWheel = 0;
+        }
+        return;
+    }
+    if (mWheel == 0) {
+        mWheel = KeepAliveWheel::instance();
+        mLastReceived = mLastSent = mWheel->now();
+    }
+    scheduleKeepAlive();
+}
+
+void DeviceManager::scheduleKeepAlive()
+{
+    if (mDevice == 0) {
+        return;
+    }
+    quint64 deadline = 0;
+    if (mKeepAliveTimeout > 0) {
+        deadline = mLastReceived + KeepAliveWheel::toTicks(mKeepAliveTimeout);
+    }
+    if (mKeepAliveInterval > 0) {
+        quint64 ping = mLastSent + KeepAliveWheel::toTicks(mKeepAliveInterval);
+        if (deadline == 0 || ping < deadline) {
+            deadline = ping;
+        }
+    }
+    mWheel->schedule(this, deadline);
+}
+
+void DeviceManager::checkKeepAlive()
+{
+    if (mWheel == 0 || mDevice == 0) {
+        return;
+    }
+    const quint64 now = mWheel->now();
+    if (mKeepAliveTimeout > 0 &&
+        now - mLastReceived >= KeepAliveWheel::toTicks(mKeepAliveTimeout)) {
+        // Not rescheduled. Keep-alive starts again on setDevice or
+        // setKeepAlive call.
+        emit peerTimeout(this);
+        return;
+    }
+    if (mKeepAliveInterval > 0 &&
+        now - mLastSent >= KeepAliveWheel::toTicks(mKeepAliveInterval)) {
+        sendControlFrame(PingFrame);
+    }
+    scheduleKeepAlive();
+}
+
+void DeviceManager::onControlFrame(quint32 frame)
+{
+    switch (frame) {
+        case PingFrame:
+            // Replied after the read loop so that several pings received at
+            // once are answered with one pong.
+            mPongRequested = true;
+            break;
+        case PongFrame:
+            // Activity is already registered by onNewData
+            break;
+        default:
+            // Datagrams may be reordered so they can't select channels
+            if (!mDatagram && frame <= quint32(ChannelFrame + MAX_CHANNEL)) {
+                mRxChannel = int(frame - ChannelFrame);
+            }
+            // Unknown control frames are reserved for future versions
+            break;
+    }
 }
 
 void DeviceManager::onNewData()
@@ -120,42 +527,427 @@ void DeviceManager::onNewData()
         return;
     }
 
+    if (mWheel != 0) {
+        mLastReceived = mWheel->now();
+    }
+
+    // New data is read when turn of this manager comes
+    if (mScheduler != 0 && mScheduler->isScheduled(this)) {
+        return;
+    }
+    readFrames();
+    finishReadPass();
+}
+
+/**
+ * Continues reading of the data arrived while reading was paused.
+ */
+void DeviceManager::onResume()
+{
+    continueReading();
+}
+
+/**
+ * Continues reading of the data left in the device when read budget was
+ * used up or reading was paused.
+ */
+void DeviceManager::continueReading()
+{
+    if (mDevice == 0 || !mDevice->isReadable()) {
+        return;
+    }
+    readFrames();
+    finishReadPass();
+}
+
+/**
+ * Schedules continuation of reading if the read budget is used up.
+ *
+ * @return true if reading should be stopped.
+ */
+bool DeviceManager::readBudgetUsed(int frames, qint64 bytes)
+{
+    if ((mReadBudgetFrames > 0 && frames >= mReadBudgetFrames) ||
+        (mReadBudgetBytes > 0 && bytes >= mReadBudgetBytes)) {
+        // Let other devices of this thread read their data first
+        if (mScheduler == 0) {
+            mScheduler = ReadScheduler::instance();
+        }
+        mScheduler->schedule(this);
+        return true;
+    }
+    return false;
+}
+
+void DeviceManager::readFrames()
+{
+    if (mDatagram) {
+        readDatagrams();
+        return;
+    }
     QDataStream reader(mDevice);
+    int frames = 0;
+    qint64 bytes = 0;
     while (reader.device()->bytesAvailable() > 0) {
+        // Data stays in the device buffer until reading is resumed
+        if (mResumeTimer.isActive()) return;
+        if (readBudgetUsed(frames, bytes)) return;
         if (mBuffer.isEmpty() && mExpectedMessageSize == 0) {
             // Not enough data waiting for the next portion.
             if (reader.device()->bytesAvailable() < sizeof(quint32)) return;
             reader >> mExpectedMessageSize;
-            // Zero sized message see Qt documentation for details
-            if (mExpectedMessageSize == quint32(0xFFFFFFFF)) {
+            bytes += sizeof(quint32);
+            if (mExpectedMessageSize >= quint32(ControlFrameBase)) {
+                quint32 frame = mExpectedMessageSize;
                 mExpectedMessageSize = 0;
+                if (hasPayload(frame)) {
+                    mPendingControlFrame = frame;
+                } else {
+                    onControlFrame(frame);
+                }
                 continue;
             }
             mReceivedPartSize = 0;
 
             // If message is too big
-            if (mMaxMessageSize > 0 && mExpectedMessageSize > mMaxMessageSize) {
+            if (mMaxMessageSize > 0 &&
+                mExpectedMessageSize > mMaxMessageSize + transportOverhead()) {
                 emit messageTooBig(this);
                 return;
             }
 
-            mBuffer.reserve(mExpectedMessageSize+1);
+            // Frame buffer is given back to the pool once frame is processed
+            mBuffer = BufferPool::local()->acquire(mExpectedMessageSize);
         }
 
         int bytesRead = reader.readRawData(
                 mBuffer.data() + mReceivedPartSize,
                 mExpectedMessageSize - mReceivedPartSize);
         if (bytesRead > 0) {
+            bytes += bytesRead;
             mReceivedPartSize += bytesRead;
-            mBuffer.resize(mReceivedPartSize);
         } else {
             /// @todo Do some IO error processing here
         }
 
         if (mReceivedPartSize == mExpectedMessageSize) {
-            emit received(mBuffer);
-            mBuffer.clear();
+            if (mPendingControlFrame != 0) {
+                quint32 frame = mPendingControlFrame;
+                mPendingControlFrame = 0;
+                emit controlFrameReceived(this, frame, mBuffer);
+            } else if (!openFrame(mBuffer)) {
+                BufferPool::local()->release(mBuffer);
+                mExpectedMessageSize = 0;
+                emit transportError(this);
+                return;
+            } else if (admitMessage()) {
+                mPassMessages++;
+                emit received(mBuffer);
+            }
+            // Recycled only if receivers kept no reference to the frame
+            BufferPool::local()->release(mBuffer);
             mExpectedMessageSize = 0;
+            frames++;
         }
     }
 }
+
+/**
+ * Datagram counterpart of readFrames. Every datagram counts as one frame
+ * against the read budget.
+ */
+void DeviceManager::readDatagrams()
+{
+    QUdpSocket *socket = static_cast<QUdpSocket*>(mDevice);
+    int datagrams = 0;
+    qint64 bytes = 0;
+    while (socket->hasPendingDatagrams()) {
+        // Datagrams stay in the socket buffer until reading is resumed
+        if (mResumeTimer.isActive()) return;
+        if (readBudgetUsed(datagrams, bytes)) return;
+
+        QByteArray datagram = BufferPool::local()->acquire(
+                int(qMax(socket->pendingDatagramSize(), qint64(0))));
+        qint64 size = socket->readDatagram(datagram.data(), datagram.size());
+        if (size < 0) {
+            BufferPool::local()->release(datagram);
+            // Errors like ICMP port unreachable don't close the socket
+            if (!socket->isReadable() ||
+                socket->state() == QAbstractSocket::UnconnectedState) {
+                emit deviceUnavailable();
+            } else {
+                mDatagramStats.receiveDropped++;
+            }
+            return;
+        }
+        datagram.resize(size);
+        datagrams++;
+        bytes += size;
+        mDatagramStats.datagramsReceived++;
+        mDatagramStats.bytesReceived += size;
+        mDatagramStats.largestReceived = qMax(mDatagramStats.largestReceived,
+                                              int(size));
+        processDatagram(datagram);
+        BufferPool::local()->release(datagram);
+    }
+}
+
+/**
+ * Datagram starting with a reserved frame size value is a control frame.
+ * Anything else is a single message without length prefix.
+ */
+void DeviceManager::processDatagram(QByteArray &datagram)
+{
+    if (datagram.size() < int(sizeof(quint32)) || !isReserved(datagram)) {
+        deliver(datagram);
+        return;
+    }
+    const uchar *data = reinterpret_cast<const uchar*>(datagram.constData());
+    quint32 frame = qFromBigEndian<quint32>(data);
+    if (frame == BatchFrame) {
+        int pos = sizeof(quint32);
+        while (pos < datagram.size()) {
+            if (datagram.size() - pos < int(sizeof(quint32))) {
+                mDatagramStats.receiveDropped++;
+                return;
+            }
+            quint32 size = qFromBigEndian<quint32>(data + pos);
+            pos += sizeof(quint32);
+            if (size > quint32(datagram.size() - pos)) {
+                mDatagramStats.receiveDropped++;
+                return;
+            }
+            QByteArray msg = BufferPool::local()->acquire(size);
+            std::memcpy(msg.data(), data + pos, size);
+            deliver(msg);
+            BufferPool::local()->release(msg);
+            pos += size;
+        }
+    } else if (hasPayload(frame)) {
+        emit controlFrameReceived(this, frame, datagram.mid(sizeof(quint32)));
+    } else {
+        onControlFrame(frame);
+    }
+}
+
+/**
+ * Checks size limit and rate limit of the message received in a datagram and
+ * emits received signal.
+ */
+void DeviceManager::deliver(QByteArray &msg)
+{
+    // Datagram is already read so the peer can't flood the memory with it.
+    // Too big message is just dropped instead of closing the connection.
+    if (mMaxMessageSize > 0 &&
+        quint32(msg.size()) > mMaxMessageSize + transportOverhead()) {
+        mDatagramStats.receiveDropped++;
+        return;
+    }
+    // Anybody can send a datagram so forged ones don't close the device
+    if (!openFrame(msg)) {
+        mDatagramStats.receiveDropped++;
+        return;
+    }
+    mDatagramStats.messagesReceived++;
+    if (admitMessage()) {
+        mPassMessages++;
+        emit received(msg);
+    }
+}
+
+/**
+ * Message starting with a reserved frame size value can't be sent without
+ * prefix since it would be taken for a control frame.
+ */
+bool DeviceManager::isReserved(const QByteArray &msg)
+{
+    if (msg.size() < int(sizeof(quint32))) {
+        return false;
+    }
+    const uchar *data = reinterpret_cast<const uchar*>(msg.constData());
+    return qFromBigEndian<quint32>(data) >= quint32(ControlFrameBase);
+}
+
+/**
+ * Queues the message to be sent in one datagram with the other messages
+ * sent during the current event loop iteration.
+ */
+void DeviceManager::sendDatagram(const QByteArray &plain)
+{
+    QByteArray msg = plain;
+    if (mTransport != 0) {
+        msg = QByteArray();
+        msg.resize(plain.size() + mTransport->overhead());
+        if (!sealFrame(plain, msg.data())) {
+            return;
+        }
+    }
+    const int alone = isReserved(msg) ? int(2*sizeof(quint32)) + msg.size()
+                                      : msg.size();
+    if (alone > mDatagramSize) {
+        mDatagramStats.sendDropped++;
+        return;
+    }
+    const int entry = int(sizeof(quint32)) + msg.size();
+    if (!mOutgoing.isEmpty() && mOutgoingSize + entry > mDatagramSize) {
+        flushDatagram();
+    }
+    if (mOutgoing.isEmpty()) {
+        mOutgoingSize = sizeof(quint32);
+    }
+    mOutgoing.append(msg);
+    mOutgoingSize += entry;
+    if (!mFlushTimer.isActive()) {
+        mFlushTimer.start(0);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Sends messages queued by send. Single message is sent as is, several ones
+ * are packed into a BatchFrame datagram.
+ */
+void DeviceManager::flushDatagram()
+{
+    mFlushTimer.stop();
+    if (mOutgoing.isEmpty()) {
+        return;
+    }
+    const int messages = mOutgoing.size();
+    if (mDevice == 0 || !mDevice->isWritable()) {
+        mDatagramStats.sendDropped += messages;
+        mOutgoing.clear();
+        mOutgoingSize = 0;
+        return;
+    }
+    QByteArray datagram;
+    if (messages == 1 && !isReserved(mOutgoing.first())) {
+        datagram = mOutgoing.first();
+    } else {
+        datagram.resize(mOutgoingSize);
+        uchar *pos = reinterpret_cast<uchar*>(datagram.data());
+        qToBigEndian<quint32>(BatchFrame, pos);
+        pos += sizeof(quint32);
+        foreach (const QByteArray &msg, mOutgoing) {
+            qToBigEndian<quint32>(msg.size(), pos);
+            pos += sizeof(quint32);
+            std::memcpy(pos, msg.constData(), msg.size());
+            pos += msg.size();
+        }
+    }
+    mOutgoing.clear();
+    mOutgoingSize = 0;
+    writeDatagram(datagram, messages);
+}
+
+void DeviceManager::writeDatagram(const QByteArray &datagram, int messages)
+{
+    if (mDevice->write(datagram) != datagram.size()) {
+        mDatagramStats.sendDropped += messages;
+        return;
+    }
+    mDatagramStats.datagramsSent++;
+    mDatagramStats.messagesSent += messages;
+    mDatagramStats.bytesSent += datagram.size();
+    mDatagramStats.largestSent = qMax(mDatagramStats.largestSent,
+                                      datagram.size());
+    if (mWheel != 0) {
+        mLastSent = mWheel->now();
+    }
+}
+
+/**
+ * Sets maximum size of the datagram sent. Messages sent during one event
+ * loop iteration are packed into datagrams of this size. Message which
+ * doesn't fit into a datagram alone is dropped.
+ *
+ * Default value DEFAULT_DATAGRAM_SIZE fits into one Ethernet frame so
+ * datagrams are not fragmented.
+ */
+void DeviceManager::setDatagramSize(int size)
+{
+    mDatagramSize = qMax(size, int(2*sizeof(quint32)));
+}
+
+/**
+ * Replies to the pings received and notifies that messages received at once
+ * are delivered.
+ */
+void DeviceManager::finishReadPass()
+{
+    if (mPongRequested) {
+        mPongRequested = false;
+        sendControlFrame(PongFrame);
+    }
+    if (mPassMessages > 0) {
+        mPassMessages = 0;
+        emit readPassFinished(this);
+    }
+}
+
+/**
+ * Takes token from the rate limit bucket for the message received.
+ *
+ * @return false if message should be dropped.
+ */
+bool DeviceManager::admitMessage()
+{
+    if (mRateLimit.take(mPauseOnLimit)) {
+        return true;
+    }
+    if (mPauseOnLimit) {
+        // Message which has already been read is delivered
+        pauseReading(mRateLimit.waitTime());
+    }
+    emit rateLimitExceeded(this);
+    return mPauseOnLimit;
+}
+
+/**
+ * Limits number of messages received per second. Control frames are not
+ * limited.
+ *
+ * @param rate number of messages per second. 0 disables the limit.
+ * @param burst number of messages which can be received at once after
+ * the idle period.
+ * @param pause if true reading is paused until the limit allows next
+ * message so unread data stays in the device buffer. Messages over the limit
+ * are dropped otherwise.
+ */
+void DeviceManager::setRateLimit(double rate, int burst, bool pause)
+{
+    mRateLimit.setLimit(rate, burst);
+    mPauseOnLimit = pause;
+    if (!mRateLimit.isLimited() && mResumeTimer.isActive()) {
+        mResumeTimer.stop();
+        onResume();
+    }
+}
+
+void DeviceManager::pauseReading(int msecs)
+{
+    if (msecs <= 0 || mResumeTimer.isActive()) {
+        return;
+    }
+    mResumeTimer.start(msecs);
+}
+
+/**
+ * Limits amount of data read from the device at once. When the limit is
+ * reached the device manager returns to the event loop and continues reading
+ * after all the other device managers of the same thread which have used up
+ * their budget. This way a peer sending lots of messages can't delay
+ * messages from the other peers for too long.
+ *
+ * Budget is checked between frames so a single frame bigger than the bytes
+ * budget is still read at once.
+ *
+ * @param frames maximum number of frames read at once. 0 means no limit.
+ * @param bytes maximum number of bytes read at once. 0 means no limit.
+ */
+void DeviceManager::setReadBudget(int frames, int bytes)
+{
+    mReadBudgetFrames = qMax(frames, 0);
+    mReadBudgetBytes = qMax(bytes, 0);
+}
@@ -10,16 +10,25 @@
 
 #include <QtCore/QtGlobal>
 #include <QtCore/QObject>
+#include <QtCore/QEvent>
 #include <QtCore/QIODevice>
 #include <QtCore/QByteArray>
 #include <QtCore/QPointer>
 #include <QtCore/QDataStream>
+#include <QtCore/QTimer>
+#include <QtCore/QList>
 
 #include "qrsexport.h"
+#include "datagramstats.h"
+#include "abstransport.h"
+#include "tokenbucket.h"
 
 namespace qrs {
 namespace internals {
 
+class KeepAliveWheel;
+class ReadScheduler;
+
 /**
  * @internal
  *
@@ -32,6 +41,36 @@ class DeviceManager : public QObject {
 Q_OBJECT
 Q_DISABLE_COPY(DeviceManager);
 public:
+    /**
+     * Values of the frame size field starting from ControlFrameBase are not
+     * treated as message sizes. Such frames are used to exchange control
+     * information between device managers. Most of them have no body. Frames
+     * listed as having payload are followed by one ordinary frame which is
+     * delivered with controlFrameReceived signal instead of received.
+     *
+     * PingFrame value is the same as QDataStream writes for a null
+     * QByteArray. Older versions of the library silently skip such frames so
+     * it's safe to send pings to them.
+     *
+     * Values from ChannelFrame to ChannelFrame + MAX_CHANNEL select logical
+     * channel of the frames following them (see send(const QByteArray &,
+     * int)). Channel 0 is selected initially so the peer which never uses
+     * channels doesn't send them. Older versions of the library read channel
+     * selectors as sizes of huge messages, so channels other than 0 require
+     * both peers to use this version.
+     */
+    enum ControlFrame {
+        ControlFrameBase = 0xFFFFFF00,
+        /// Following frames belong to the channel (frame - ChannelFrame).
+        ChannelFrame = ControlFrameBase,
+        /// Several length prefixed messages in one datagram.
+        BatchFrame = 0xFFFFFFFC,
+        /// Protocol negotiation. Has payload.
+        HelloFrame = 0xFFFFFFFD,
+        PongFrame = 0xFFFFFFFE,
+        PingFrame = 0xFFFFFFFF
+    };
+
     /**
      * @brief Default constructor
      *
@@ -40,7 +79,7 @@ public:
      */
     explicit DeviceManager(QObject *parent = 0);
     DeviceManager(QIODevice *device, QObject *parent);
-    ~DeviceManager() {};
+    ~DeviceManager();
 
     /// Returns QIODevice used for IO operations.
     const QIODevice* device() const {return mDevice;};
@@ -56,6 +95,65 @@ public:
      * @sa mMaxMessageSize
      */
     quint32 maxMessageSize() const {return mMaxMessageSize;}
+
+    void setKeepAlive(int interval, int timeout);
+    /**
+     * @sa setKeepAlive
+     */
+    int keepAliveInterval() const {return mKeepAliveInterval;}
+    /**
+     * @sa setKeepAlive
+     */
+    int keepAliveTimeout() const {return mKeepAliveTimeout;}
+
+    void setRateLimit(double rate, int burst, bool pause);
+    /// @brief Stops reading frames from the device for the given time.
+    void pauseReading(int msecs);
+    /// @brief Reading is paused by the rate limit.
+    bool isReadingPaused() const {return mResumeTimer.isActive();}
+
+    void setReadBudget(int frames, int bytes);
+    /**
+     * @sa setReadBudget
+     */
+    int readBudgetFrames() const {return mReadBudgetFrames;}
+    /**
+     * @sa setReadBudget
+     */
+    int readBudgetBytes() const {return mReadBudgetBytes;}
+
+    void setTransport(AbsTransport *transport);
+    /**
+     * @sa setTransport
+     */
+    AbsTransport *transport() const {return mTransport;}
+
+    /// @brief Device is QUdpSocket. Each datagram is a separate message.
+    bool isDatagram() const {return mDatagram;}
+    void setDatagramSize(int size);
+    /**
+     * @sa setDatagramSize
+     */
+    int datagramSize() const {return mDatagramSize;}
+    /// @brief 1500 bytes Ethernet MTU minus IPv4 and UDP headers
+    static const int DEFAULT_DATAGRAM_SIZE = 1472;
+    const DatagramStats &datagramStats() const {return mDatagramStats;}
+
+    void sendControlFrame(ControlFrame frame);
+    void sendControlFrame(ControlFrame frame, const QByteArray &payload,
+                          int channel = 0);
+    void send(const QByteArray &msg, int channel);
+    void sendFrame(const QByteArray &frame, int channel);
+    /// @brief Size of the frame size field preceding the message
+    static const int FRAME_HEADER = sizeof(quint32);
+    /// @brief Channel of the frame being delivered
+    int receiveChannel() const {return mRxChannel;}
+    /// @brief Biggest channel number. Datagram devices use channel 0 only.
+    static const int MAX_CHANNEL = 0xEF;
+    /// @internal Called by KeepAliveWheel when deadline of this manager comes.
+    void checkKeepAlive();
+    /// @internal Called by ReadScheduler when turn of this manager comes.
+    void continueReading();
 public slots:
     void send(const QByteArray& msg);
 signals:
@@ -77,9 +175,49 @@ signals:
      * then value specified by the mMaxMessageSize property.
      */
     void messageTooBig(qrs::internals::DeviceManager *);
+    /**
+     * This signal is emitted if keep-alive is enabled and nothing was
+     * received from the device during the keep-alive timeout.
+     *
+     * @sa setKeepAlive
+     */
+    void peerTimeout(qrs::internals::DeviceManager *);
+    /**
+     * This signal is emitted when control frame having payload is received.
+     */
+    void controlFrameReceived(qrs::internals::DeviceManager *,
+                              quint32 frame, QByteArray payload);
+    /**
+     * This signal is emitted when message received exceeds the rate limit.
+     * Message is already dropped or reading is paused at this point.
+     *
+     * @sa setRateLimit
+     */
+    void rateLimitExceeded(qrs::internals::DeviceManager *);
+    /**
+     * This signal is emitted when all the messages available in the device
+     * (or allowed by the read budget) are received with the received
+     * signal. It's not emitted if no message was received.
+     */
+    void readPassFinished(qrs::internals::DeviceManager *);
+    /**
+     * This signal is emitted when transport rejects the frame received from
+     * the stream device or fails to protect the message sent. Frames of the
+     * datagram devices rejected by the transport are dropped silently.
+     *
+     * @sa setTransport
+     */
+    void transportError(qrs::internals::DeviceManager *);
+protected:
+    virtual bool event(QEvent *e);
 private slots:
     void onNewData();
+    void onThreadChanged(bool reading);
+    void onResume();
+    void flushDatagram();
 private:
+    void init();
+
     QPointer<QIODevice> mDevice;
     QDataStream mStream;
     QByteArray mBuffer;
@@ -93,6 +231,73 @@ private:
      * Default value 0 means no message size limitation.
      */
     quint32 mMaxMessageSize;
+
+    /// Idle interval in ms after which ping is sent. 0 means never.
+    int mKeepAliveInterval;
+    /// Silence interval in ms after which the peer is dead. 0 means never.
+    int mKeepAliveTimeout;
+    /**
+     * Shared wheel of the current thread or 0 if keep-alive is disabled.
+     * Reset when the thread finishes and the wheel is deleted.
+     */
+    QPointer<KeepAliveWheel> mWheel;
+    /// Wheel ticks of the last data read from and written to the device.
+    quint64 mLastReceived;
+    quint64 mLastSent;
+    /// Set if ping was received during the current onNewData call.
+    bool mPongRequested;
+    /// Control frame waiting for its payload or 0.
+    quint32 mPendingControlFrame;
+    /// Limit on the number of received messages.
+    TokenBucket mRateLimit;
+    /// Pause reading instead of dropping messages over the limit.
+    bool mPauseOnLimit;
+    /// Active while reading is paused.
+    QTimer mResumeTimer;
+    /// Maximum number of frames read at once or 0.
+    int mReadBudgetFrames;
+    /// Maximum number of bytes read at once or 0.
+    int mReadBudgetBytes;
+    /// Scheduler this manager was queued to or 0 if never queued.
+    QPointer<ReadScheduler> mScheduler;
+    /// Number of messages received since the read pass started.
+    int mPassMessages;
+    /// Device is QUdpSocket.
+    bool mDatagram;
+    /// Maximum size of the datagram sent.
+    int mDatagramSize;
+    /// Messages waiting to be sent in one datagram.
+    QList<QByteArray> mOutgoing;
+    /// Size of the batch datagram with all the waiting messages.
+    int mOutgoingSize;
+    /// Active while messages are waiting to be sent.
+    QTimer mFlushTimer;
+    DatagramStats mDatagramStats;
+    /// Frame protection layer owned by this manager.
+    AbsTransport *mTransport;
+    /// Reused buffer for the protected frames sent.
+    QByteArray mSendBuffer;
+    /// Channels selected by the last ChannelFrame sent and received.
+    int mTxChannel;
+    int mRxChannel;
+
+    void readFrames();
+    bool readBudgetUsed(int frames, qint64 bytes);
+    void readDatagrams();
+    void processDatagram(QByteArray &datagram);
+    void deliver(QByteArray &msg);
+    void sendDatagram(const QByteArray &plain);
+    void writeDatagram(const QByteArray &datagram, int messages);
+    static bool isReserved(const QByteArray &msg);
+    int transportOverhead() const;
+    bool openFrame(QByteArray &frame);
+    bool sealFrame(const QByteArray &msg, char *out);
+    void finishReadPass();
+    bool admitMessage();
+    void scheduleKeepAlive();
+    void onControlFrame(quint32 frame);
+    void selectChannel(int channel);
+    static bool hasPayload(quint32 frame);
 };
 
 } // namespace internals
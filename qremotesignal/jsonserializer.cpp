@@ -6,6 +6,7 @@
  * @date 5 Sep 2009
  */
 #include "jsonserializer.h"
+#include "record.h"
 
 // QJson
 #include <qjson/parser.h>
@@ -25,6 +26,52 @@ const QString RC_PARAMS_KEY = "params";
 
 using namespace qrs;
 
+/**
+ * Replaces Record and RecordList values with objects and arrays QJson can
+ * write. Lists and maps are rebuilt only if they contain records.
+ *
+ * @return true if value was changed
+ */
+static bool replaceRecords(QVariant &value) {
+   const Record *rec = Record::get(value);
+   if ( rec != 0 ) {
+      QVariant res = rec->toVariant();
+      replaceRecords(res);
+      value = res;
+      return true;
+   }
+   const RecordList *list = RecordList::get(value);
+   if ( list != 0 ) {
+      QVariant res = list->toVariant();
+      replaceRecords(res);
+      value = res;
+      return true;
+   }
+   if ( value.type() == QVariant::List ) {
+      QVariantList items = value.toList();
+      bool changed = false;
+      for (QVariantList::iterator it = items.begin(); it != items.end(); ++it) {
+         changed = replaceRecords(*it) || changed;
+      }
+      if ( changed ) {
+         value = items;
+      }
+      return changed;
+   }
+   if ( value.type() == QVariant::Map ) {
+      QVariantMap items = value.toMap();
+      bool changed = false;
+      for (QVariantMap::iterator it = items.begin(); it != items.end(); ++it) {
+         changed = replaceRecords(it.value()) || changed;
+      }
+      if ( changed ) {
+         value = items;
+      }
+      return changed;
+   }
+   return false;
+}
+
 QByteArray JsonSerializer::serialize ( const Message& msg )
       throw(UnsupportedTypeException) {
    QJson::Serializer serializer;
@@ -34,7 +81,9 @@ QByteArray JsonSerializer::serialize ( const Message& msg )
 
    QVariantMap jsonObject;
    if ( msg.type() == Message::RemoteCall ) {
-      message.insert( RC_PARAMS_KEY,QVariant(msg.params()) );
+      QVariant params(msg.params());
+      replaceRecords(params);
+      message.insert( RC_PARAMS_KEY,params );
       jsonObject.insert(REMOTE_CALL_TYPE,QVariant(message));
    } else if ( msg.type() == Message::Error ) {
       message.insert( ERROR_DESCRIPTION_KEY,msg.error() );
@@ -46,22 +95,46 @@ QByteArray JsonSerializer::serialize ( const Message& msg )
    return serializer.serialize( QVariant(jsonObject) );
 }
 
+bool JsonSerializer::recognizes ( const QByteArray& msg ) const {
+   for ( int i = 0; i < msg.size(); i++ ) {
+      switch ( msg[i] ) {
+         case ' ': case '\t': case '\r': case '\n':
+            continue;
+         case '{':
+            return true;
+         default:
+            return false;
+      }
+   }
+   return false;
+}
+
 MessageAP JsonSerializer::deserialize ( const QByteArray& msg )
       throw(MessageParsingException) {
+   Status status;
+   MessageAP res = deserialize(msg, status);
+   if ( !status.isOk() ) {
+      MessageParsingException err(status.detail(),status.code());
+      throw( err );
+   }
+   return res;
+}
+
+MessageAP JsonSerializer::deserialize ( const QByteArray& msg, Status &status ) {
    QJson::Parser parser;
    bool ok;
    // trying to parse incoming message
    QVariantMap result = parser.parse (msg, &ok).toMap();
    if ( !ok ) {
-      QString desc = "JSON error. line %1: %2";
-      desc = desc.arg(parser.errorLine()).arg(parser.errorString());
-      MessageParsingException err(desc,Message::ProtocolError);
-      throw( err );
+      status = Status(Message::ProtocolError,
+                      QT_TRANSLATE_NOOP("QObject", "JSON error. line %1: %2"),
+                      parser.errorLine(), parser.errorString());
+      return MessageAP();
    }
    if ( result.isEmpty() ) {
-      QString desc = "Empty JSON message";
-      MessageParsingException err(desc,Message::ProtocolError);
-      throw( err );
+      status = Status(Message::ProtocolError,
+                      QT_TRANSLATE_NOOP("QObject", "Empty JSON message"));
+      return MessageAP();
    }
    // Checking message type
    QString messageType = result.keys().first();
@@ -102,9 +175,9 @@ MessageAP JsonSerializer::deserialize ( const QByteArray& msg )
       return res;
    } else {
       // Unknown message type
-      QString desc = "Unknown message type \"%1\"";
-      desc = desc.arg(messageType);
-      MessageParsingException err(desc,Message::UnknownMsgType);
-      throw( err );
+      status = Status(Message::UnknownMsgType,
+                      QT_TRANSLATE_NOOP("QObject", "Unknown message type \"%1\""),
+                      messageType);
+      return MessageAP();
    }
 }
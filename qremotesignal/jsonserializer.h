@@ -112,6 +112,12 @@ namespace qrs {
          /// @copydoc AbsMessageSerializer::deserialize
          virtual MessageAP deserialize ( const QByteArray& msg )
                throw(MessageParsingException);
+         /// @copydoc AbsMessageSerializer::deserialize(const QByteArray&,Status&)
+         virtual MessageAP deserialize ( const QByteArray& msg, Status &status );
+         /// @copydoc AbsMessageSerializer::protocolId
+         virtual QByteArray protocolId() const {return "json";}
+         /// @brief Message starts with '{' after optional whitespaces
+         virtual bool recognizes ( const QByteArray& msg ) const;
       private:
          Q_DISABLE_COPY(JsonSerializer);
    };
@@ -0,0 +1,104 @@
+/**
+ * @file keepalivewheel.cpp
+ * @brief KeepAliveWheel implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "keepalivewheel.h"
+
+#include <QtCore/QThreadStorage>
+
+#include "devicemanager.h"
+
+using namespace qrs;
+using namespace qrs::internals;
+
+// QThreadStorage deletes the wheel when its thread finishes.
+static QThreadStorage<KeepAliveWheel*> threadWheel;
+
+KeepAliveWheel::KeepAliveWheel():
+        QObject(0),
+        mNow(0),
+        mWheel(WHEEL_SIZE)
+{
+    mTimer.setInterval(TICK_INTERVAL);
+    connect(&mTimer, SIGNAL(timeout()),
+            this, SLOT(tick()));
+}
+
+KeepAliveWheel *KeepAliveWheel::instance()
+{
+    if (!threadWheel.hasLocalData()) {
+        threadWheel.setLocalData(new KeepAliveWheel);
+    }
+    return threadWheel.localData();
+}
+
+/**
+ * Rounds up so that a non zero interval is never shorter than one tick.
+ */
+quint64 KeepAliveWheel::toTicks(int msecs)
+{
+    if (msecs <= 0) {
+        return 0;
+    }
+    return (quint64(msecs) + TICK_INTERVAL - 1)/TICK_INTERVAL;
+}
+
+/**
+ * Schedules device manager to be woken up at the given tick. If the device
+ * manager was already scheduled its previous deadline is replaced.
+ */
+void KeepAliveWheel::schedule(DeviceManager *dm, quint64 tick)
+{
+    cancel(dm);
+    quint64 delta = tick > mNow ? tick - mNow : 1;
+    if (delta >= quint64(WHEEL_SIZE)) {
+        delta = WHEEL_SIZE - 1;
+    }
+    int pos = int((mNow + delta) % WHEEL_SIZE);
+    mWheel[pos].insert(dm);
+    mPositions.insert(dm, pos);
+    if (!mTimer.isActive()) {
+        mTimer.start();
+    }
+}
+
+void KeepAliveWheel::cancel(DeviceManager *dm)
+{
+    QHash<DeviceManager*, int>::iterator it = mPositions.find(dm);
+    if (it == mPositions.end()) {
+        return;
+    }
+    mWheel[it.value()].remove(dm);
+    mPositions.erase(it);
+    if (mPositions.isEmpty()) {
+        mTimer.stop();
+    }
+}
+
+void KeepAliveWheel::tick()
+{
+    mNow++;
+    int pos = int(mNow % WHEEL_SIZE);
+    if (mWheel[pos].isEmpty()) {
+        return;
+    }
+    QSet<DeviceManager*> due = mWheel[pos];
+    mWheel[pos].clear();
+    foreach (DeviceManager *dm, due) {
+        // Device manager can be cancelled or deleted by the previous one
+        // handler (for example if both of them are owned by the same
+        // ServicesManager). Deleted managers cancel themselves.
+        QHash<DeviceManager*, int>::iterator it = mPositions.find(dm);
+        if (it == mPositions.end() || it.value() != pos) {
+            continue;
+        }
+        mPositions.erase(it);
+        dm->checkKeepAlive();
+    }
+    if (mPositions.isEmpty()) {
+        mTimer.stop();
+    }
+}
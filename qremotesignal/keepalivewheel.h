@@ -0,0 +1,73 @@
+/**
+ * @file keepalivewheel.h
+ * @brief KeepAliveWheel class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _KeepAliveWheel_H
+#define _KeepAliveWheel_H
+
+#include <QtCore/QtGlobal>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <QtCore/QSet>
+#include <QtCore/QHash>
+
+namespace qrs {
+namespace internals {
+
+class DeviceManager;
+
+/**
+ * @internal
+ *
+ * Hashed timer wheel shared by all DeviceManager instances living in the same
+ * thread. It has a single QTimer ticking every TICK_INTERVAL milliseconds
+ * while at least one device manager is scheduled so the keep-alive cost
+ * doesn't grow with the number of devices.
+ *
+ * Time is measured in wheel ticks. Device managers store ticks of their last
+ * activity and the wheel only wakes them up when their deadline slot comes.
+ * Deadlines which are further than the wheel size are rounded down to the
+ * last slot and the device manager simply reschedules itself when woken up.
+ */
+class KeepAliveWheel : public QObject {
+Q_OBJECT
+Q_DISABLE_COPY(KeepAliveWheel);
+public:
+    /// Wheel resolution in milliseconds.
+    static const int TICK_INTERVAL = 100;
+    /// Number of slots in the wheel.
+    static const int WHEEL_SIZE = 512;
+
+    /// @brief Wheel instance for the current thread.
+    static KeepAliveWheel *instance();
+
+    /// @brief Converts interval in milliseconds to the number of wheel ticks.
+    static quint64 toTicks(int msecs);
+
+    /// @brief Number of ticks passed since the wheel was created.
+    quint64 now() const {return mNow;}
+
+    void schedule(DeviceManager *dm, quint64 tick);
+    void cancel(DeviceManager *dm);
+
+public slots:
+    /// @brief Advances the wheel. Called by the timer or directly by tests.
+    void tick();
+
+private:
+    KeepAliveWheel();
+
+    QTimer mTimer;
+    quint64 mNow;
+    QVector< QSet<DeviceManager*> > mWheel;
+    QHash<DeviceManager*, int> mPositions;
+};
+
+} // namespace internals
+} // namespace qrs
+
+#endif
@@ -7,11 +7,26 @@
  */
 #include "message.h"
 
+#include <QtCore/QDataStream>
+
 using namespace qrs;
 
 namespace qrs {
     namespace internals {
         class MessagePrivate {
+        public:
+            MessagePrivate(): mOffset(0), mVersion(0), mPending(false),
+                mCorrupted(false) {}
+
+            /// Serialized message holding the params not decoded yet
+            QByteArray mRaw;
+            /// Position of the params in mRaw
+            int mOffset;
+            /// QDataStream version used to write the params
+            int mVersion;
+            bool mPending;
+            /// Raw params failed to be decoded
+            bool mCorrupted;
         };
     }
 }
@@ -20,6 +35,108 @@ Message::Message(): d(new internals::MessagePrivate) {
     mType = RemoteCall; mErrorType = Ok;
 }
 
+/**
+ * Copies are cheap: strings, params and raw params not decoded yet are
+ * implicitly shared with the @a other message.
+ */
+Message::Message(const Message& other):
+    mService(other.mService), mMethod(other.mMethod), mParams(other.mParams),
+    mType(other.mType), mErrorType(other.mErrorType), mError(other.mError),
+    d(new internals::MessagePrivate(*other.d))
+{
+}
+
+Message& Message::operator= (const Message& other) {
+    mService = other.mService;
+    mMethod = other.mMethod;
+    mParams = other.mParams;
+    mType = other.mType;
+    mErrorType = other.mErrorType;
+    mError = other.mError;
+    *d = *other.d;
+    return *this;
+}
+
 Message::~Message() {
     delete d;
 }
+
+const QVariantMap& Message::params() const {
+    decodeParams();
+    return mParams;
+}
+
+QVariantMap& Message::params() {
+    decodeParams();
+    return mParams;
+}
+
+void Message::setParams(const QVariantMap& val) {
+    d->mRaw = QByteArray();
+    d->mPending = false;
+    d->mCorrupted = false;
+    mParams = val;
+}
+
+/**
+ * @brief Sets params serialized with QDataStream to be decoded on first access
+ *
+ * Lets the serializer skip params decoding for the messages nobody is going
+ * to look into. Raw message is implicitly shared so no data is copied. It
+ * must not be created with QByteArray::fromRawData() unless the data outlives
+ * the message.
+ *
+ * @param raw serialized message
+ * @param offset position of the params map in the @a raw
+ * @param version QDataStream version used to write the params or 0 for the
+ * default one
+ */
+void Message::setRawParams(const QByteArray& raw, int offset, int version) {
+    mParams.clear();
+    d->mRaw = raw;
+    d->mOffset = offset;
+    d->mVersion = version;
+    d->mPending = true;
+    d->mCorrupted = false;
+}
+
+/**
+ * @brief Returns false if raw params set with setRawParams were not accessed yet
+ */
+bool Message::paramsDecoded() const {
+    return !d->mPending;
+}
+
+/**
+ * @brief Decodes raw params if needed and checks if they were corrupted
+ *
+ * Corrupted params are decoded as empty map. Generated services reject
+ * such a message with Message::ProtocolError.
+ */
+bool Message::paramsCorrupted() const {
+    decodeParams();
+    return d->mCorrupted;
+}
+
+/**
+ * Corrupted params are decoded as empty map and recorded to be reported by
+ * paramsCorrupted.
+ */
+void Message::decodeParams() const {
+    if ( !d->mPending ) {
+        return;
+    }
+    d->mPending = false;
+    const QByteArray params = QByteArray::fromRawData(d->mRaw.constData() + d->mOffset,
+                                                      d->mRaw.size() - d->mOffset);
+    QDataStream stream(params);
+    if ( d->mVersion != 0 ) {
+        stream.setVersion(d->mVersion);
+    }
+    stream >> mParams;
+    if ( stream.status() != QDataStream::Ok ) {
+        mParams.clear();
+        d->mCorrupted = true;
+    }
+    d->mRaw = QByteArray();
+}
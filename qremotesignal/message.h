@@ -10,6 +10,7 @@
 
 #include <memory>
 
+#include <QtCore/QByteArray>
 #include <QtCore/QString>
 #include <QtCore/QVariantMap>
 
@@ -39,6 +40,8 @@ namespace qrs {
     class QRS_EXPORT Message {
         public:
             Message();
+            Message(const Message& other);
+            Message& operator= (const Message& other);
             virtual ~Message();
 
             enum MsgType {RemoteCall = 0,Error = -1};
@@ -110,11 +113,17 @@ namespace qrs {
             */
             const QString& method() const {return mMethod;}
 
-            const QVariantMap& params() const {return mParams;};
-            QVariantMap& params() {return mParams;};
-            void setParams(const QVariantMap& val) {mParams = val;};
+            const QVariantMap& params() const;
+            QVariantMap& params();
+            void setParams(const QVariantMap& val);
+
+            void setRawParams(const QByteArray& raw, int offset, int version);
+            bool paramsDecoded() const;
+            bool paramsCorrupted() const;
 
         private:
+            void decodeParams() const;
+
             /**
             * @brief service name
             *
@@ -141,8 +150,10 @@ namespace qrs {
             QString mMethod;
             /**
             * @brief Map of method parameters.
+            *
+            * Decoded from the raw params on first access.
             */
-            QVariantMap mParams;
+            mutable QVariantMap mParams;
 
             MsgType mType;
             ErrorType mErrorType;
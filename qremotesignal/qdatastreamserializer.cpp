@@ -9,8 +9,31 @@
 
 #include <QtCore/QBuffer>
 
+#include "bufferpool.h"
+
 using namespace qrs;
 
+namespace {
+
+    /// Discards data written counting its size
+    class SizeCounter: public QIODevice {
+        public:
+            SizeCounter(): mCounted(0) {open(QIODevice::WriteOnly);}
+            qint64 counted() const {return mCounted;}
+
+        protected:
+            virtual qint64 readData(char *, qint64) {return -1;}
+            virtual qint64 writeData(const char *, qint64 len) {
+                mCounted += len;
+                return len;
+            }
+
+        private:
+            qint64 mCounted;
+    };
+
+}
+
 QDataStream &operator<<(QDataStream &stream, const Message &msg) {
     qint8 type,errorType;
     type = (qint8)msg.type();
@@ -22,10 +45,10 @@ QDataStream &operator<<(QDataStream &stream, const Message &msg) {
     return stream;
 }
 
-QDataStream &operator>>(QDataStream &stream, Message &msg) {
+/// Reads everything but params
+static QDataStream &readHeader(QDataStream &stream, Message &msg) {
     qint8 type,errorType;
     QString error,service,method;
-    QVariantMap params;
     stream >> type;
     if ( stream.status() != QDataStream::Ok ) return stream;
     stream >> errorType;
@@ -36,48 +59,106 @@ QDataStream &operator>>(QDataStream &stream, Message &msg) {
     if ( stream.status() != QDataStream::Ok ) return stream;
     stream >> method;
     if ( stream.status() != QDataStream::Ok ) return stream;
-    stream >> params;
-    if ( stream.status() != QDataStream::Ok ) return stream;
     msg.setType((Message::MsgType)type);
     msg.setErrorType((Message::ErrorType)errorType);
     msg.setError(error);
     msg.setService(service);
     msg.setMethod(method);
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, Message &msg) {
+    QVariantMap params;
+    readHeader(stream, msg);
+    if ( stream.status() != QDataStream::Ok ) return stream;
+    stream >> params;
+    if ( stream.status() != QDataStream::Ok ) return stream;
     msg.setParams(params);
     return stream;
 }
 
+bool QDataStreamSerializer::recognizes(const QByteArray &msg) const {
+    if ( msg.size() < 2 ) return false;
+    const qint8 type = qint8(msg[0]);
+    return type == qint8(Message::RemoteCall) || type == qint8(Message::Error);
+}
+
 MessageAP QDataStreamSerializer::deserialize(const QByteArray& msg)
         throw(MessageParsingException) {
+    Status status;
+    MessageAP res = deserialize(msg, status);
+    if ( !status.isOk() ) {
+        MessageParsingException err(status.detail(),status.code());
+        throw(err);
+    }
+    return res;
+}
+
+MessageAP QDataStreamSerializer::deserialize(const QByteArray& msg,
+                                             Status &status) {
     QBuffer dev;
     dev.setData(msg);
     dev.open(QIODevice::ReadOnly);
     QDataStream stream(&dev);
     if ( version() != 0 ) stream.setVersion( version() );
-    Message *message = new Message;
-    stream >> *message;
+    MessageAP message(new Message);
+    readHeader(stream, *message);
+    // Params are decoded on first access. Only the map size is checked here
+    // so truncated message is still rejected by the serializer.
+    if ( stream.status() == QDataStream::Ok && dev.bytesAvailable() < qint64(sizeof(quint32)) ) {
+        stream.setStatus(QDataStream::ReadPastEnd);
+    }
     if ( stream.status() != QDataStream::Ok ) {
-        QString desc;
+        const char *desc = "";
         switch( stream.status() ) {
             case QDataStream::ReadPastEnd :
-                desc = "Message incompleate";
+                desc = QT_TRANSLATE_NOOP("QObject", "Message incompleate");
                 break;
             case QDataStream::ReadCorruptData :
-                desc = "Message corrupted";
+                desc = QT_TRANSLATE_NOOP("QObject", "Message corrupted");
+                break;
+            default:
                 break;
         }
-        MessageParsingException err(desc,Message::ProtocolError);
-        throw(err);
+        status = Status(Message::ProtocolError, desc);
+        return MessageAP();
     }
-    return MessageAP(message);
+    message->setRawParams(msg, int(dev.pos()), version());
+    return message;
 }
 
 QByteArray QDataStreamSerializer::serialize( const Message& msg )
         throw(UnsupportedTypeException) {
-    QBuffer dev;
-    dev.open(QIODevice::WriteOnly);
+    return serializeAt(msg, 0);
+}
+
+/**
+ * Exact size of the message is computed first so the message is written
+ * into the array taken from the thread buffer pool without reallocations.
+ * Manager gives the result back to the pool after sending.
+ */
+QByteArray QDataStreamSerializer::serializeAt( const Message& msg, int offset )
+        throw(UnsupportedTypeException) {
+    QByteArray res = internals::BufferPool::local()->acquire(offset + serializedSize(msg));
+    QBuffer dev(&res);
+    // ReadWrite doesn't truncate the array
+    dev.open(QIODevice::ReadWrite);
+    dev.seek(offset);
+    QDataStream stream(&dev);
+    if ( version() != 0 ) stream.setVersion( version() );
+    stream << msg;
+    return res;
+}
+
+/**
+ * Message is written to the device discarding the data so nothing is
+ * allocated. Values of the custom types are sized by their own stream
+ * operators.
+ */
+int QDataStreamSerializer::serializedSize( const Message& msg ) const {
+    SizeCounter dev;
     QDataStream stream(&dev);
     if ( version() != 0 ) stream.setVersion( version() );
     stream << msg;
-    return dev.data();
+    return int(dev.counted());
 }
@@ -13,6 +13,7 @@
 #include "qrsexport.h"
 #include "absmessageserializer.h"
 #include "globalserializer.h"
+#include "record.h"
 
 QDataStream &operator<<(QDataStream &stream, const qrs::Message &msg);
 QDataStream &operator>>(QDataStream &stream, qrs::Message &msg);
@@ -35,6 +36,10 @@ namespace qrs {
      *   -# Service name as @b QString.
      *   -# Method name as @b QString.
      *   -# Renote call parameters as @b QVariantMap.
+     *
+     * Structures declared in the interface XML are written as qrs::Record
+     * and qrs::RecordList values containing only field values in the order
+     * of declaration.
      * 
      * You can create and manage instances of this class manually but it's more
      * convivient to use predefined macroses which allows you to have one
@@ -56,18 +61,45 @@ namespace qrs {
     class QRS_EXPORT QDataStreamSerializer : public AbsMessageSerializer {
         public:
             explicit QDataStreamSerializer(QObject *parent = 0):
-                AbsMessageSerializer(parent) {}
+                AbsMessageSerializer(parent) {Record::registerMetaTypes();}
             explicit QDataStreamSerializer(int version, QObject *parent = 0):
-                AbsMessageSerializer(version,parent) {}
+                AbsMessageSerializer(version,parent) {Record::registerMetaTypes();}
             virtual ~QDataStreamSerializer() {}
 
             /// @copydoc AbsMessageSerializer::deserialize
             virtual MessageAP deserialize(const QByteArray& msg) 
                 throw(MessageParsingException);
 
+            /// @copydoc AbsMessageSerializer::deserialize(const QByteArray&,Status&)
+            virtual MessageAP deserialize(const QByteArray& msg, Status &status);
+
             /// @copydoc AbsMessageSerializer::serialize
             virtual QByteArray serialize( const Message& msg )
                 throw(UnsupportedTypeException);
+
+            /// @copydoc AbsMessageSerializer::serializeAt
+            virtual QByteArray serializeAt( const Message& msg, int offset )
+                throw(UnsupportedTypeException);
+
+            /// @brief Exact size of the raw message
+            int serializedSize( const Message& msg ) const;
+
+            /**
+             * @return "qdatastream/" followed by the QDataStream version or
+             * empty array for the instance using latest protocol version
+             * since it depends on the Qt library at build time.
+             */
+            virtual QByteArray protocolId() const {
+                if ( version() == 0 ) return QByteArray();
+                return "qdatastream/" + QByteArray::number(version());
+            }
+
+            /**
+             * @return true if the message starts with Message::RemoteCall or
+             * Message::Error type byte. Version of the QDataStream protocol
+             * can't be recognized.
+             */
+            virtual bool recognizes(const QByteArray &msg) const;
                 
         private:
             Q_DISABLE_COPY(QDataStreamSerializer);
@@ -0,0 +1,79 @@
+/**
+ * @file readscheduler.cpp
+ * @brief ReadScheduler implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "readscheduler.h"
+
+#include <QtCore/QMetaObject>
+#include <QtCore/QThreadStorage>
+
+#include "devicemanager.h"
+
+using namespace qrs;
+using namespace qrs::internals;
+
+// QThreadStorage deletes the scheduler when its thread finishes.
+static QThreadStorage<ReadScheduler*> threadScheduler;
+
+ReadScheduler::ReadScheduler():
+        QObject(0),
+        mTurnPosted(false)
+{
+}
+
+ReadScheduler *ReadScheduler::instance()
+{
+    if (!threadScheduler.hasLocalData()) {
+        threadScheduler.setLocalData(new ReadScheduler);
+    }
+    return threadScheduler.localData();
+}
+
+/**
+ * Puts device manager to the end of the queue. Device manager which is
+ * already queued keeps its place.
+ */
+void ReadScheduler::schedule(DeviceManager *dm)
+{
+    if (mScheduled.contains(dm)) {
+        return;
+    }
+    mScheduled.insert(dm);
+    mQueue.enqueue(dm);
+    postTurn();
+}
+
+void ReadScheduler::cancel(DeviceManager *dm)
+{
+    if (!mScheduled.remove(dm)) {
+        return;
+    }
+    mQueue.removeAll(dm);
+}
+
+void ReadScheduler::postTurn()
+{
+    if (mTurnPosted) {
+        return;
+    }
+    mTurnPosted = true;
+    QMetaObject::invokeMethod(this, "onTurn", Qt::QueuedConnection);
+}
+
+void ReadScheduler::onTurn()
+{
+    mTurnPosted = false;
+    // Managers rescheduled during this turn are behind this boundary
+    int count = mQueue.size();
+    while (count-- > 0 && !mQueue.isEmpty()) {
+        DeviceManager *dm = mQueue.dequeue();
+        mScheduled.remove(dm);
+        dm->continueReading();
+    }
+    if (!mQueue.isEmpty()) {
+        postTurn();
+    }
+}
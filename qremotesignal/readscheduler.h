@@ -0,0 +1,61 @@
+/**
+ * @file readscheduler.h
+ * @brief ReadScheduler class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _ReadScheduler_H
+#define _ReadScheduler_H
+
+#include <QtCore/QtGlobal>
+#include <QtCore/QObject>
+#include <QtCore/QQueue>
+#include <QtCore/QSet>
+
+namespace qrs {
+namespace internals {
+
+class DeviceManager;
+
+/**
+ * @internal
+ *
+ * Round-robin queue of device managers which have used up their read budget
+ * while data was still available. Shared by all DeviceManager instances
+ * living in the same thread.
+ *
+ * Each turn continues reading of the device managers queued before the turn
+ * started. Managers exhausting their budget again are put to the end of the
+ * queue and wait for the next turn. Turns are posted to the event loop so
+ * socket notifications and timers of other devices are processed between
+ * them.
+ */
+class ReadScheduler : public QObject {
+Q_OBJECT
+Q_DISABLE_COPY(ReadScheduler);
+public:
+    /// @brief Scheduler instance for the current thread.
+    static ReadScheduler *instance();
+
+    void schedule(DeviceManager *dm);
+    void cancel(DeviceManager *dm);
+    bool isScheduled(DeviceManager *dm) const {return mScheduled.contains(dm);}
+
+private slots:
+    void onTurn();
+
+private:
+    ReadScheduler();
+
+    void postTurn();
+
+    QQueue<DeviceManager*> mQueue;
+    QSet<DeviceManager*> mScheduled;
+    bool mTurnPosted;
+};
+
+} // namespace internals
+} // namespace qrs
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file record.cpp
+ * @brief Record and RecordList classes implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "record.h"
+
+#include <climits>
+
+using namespace qrs;
+
+/**
+ * @return QVariantMap with field names as keys if the record knows names of
+ * its fields or QVariantList with field values otherwise.
+ */
+QVariant Record::toVariant() const {
+   if ( mFields == 0 || mFields->size() != mValues.size() ) {
+      return QVariant(mValues);
+   }
+   QVariantMap res;
+   for (int i = 0; i < mValues.size(); i++) {
+      // Positions of removed fields have no names
+      if ( !mFields->at(i).isEmpty() ) {
+         res.insert(mFields->at(i), mValues.at(i));
+      }
+   }
+   return QVariant(res);
+}
+
+const Record *Record::get(const QVariant &arg) {
+   if ( arg.userType() != qMetaTypeId<Record>() ) {
+      return 0;
+   }
+   return static_cast<const Record*>(arg.constData());
+}
+
+/**
+ * Registers Record and RecordList types together with their QDataStream
+ * operators. QDataStreamSerializer calls this function so there is no need to
+ * call it manually.
+ */
+void Record::registerMetaTypes() {
+   static bool registered = false;
+   if ( registered ) {
+      return;
+   }
+   qRegisterMetaType<Record>("qrs::Record");
+   qRegisterMetaTypeStreamOperators<Record>("qrs::Record");
+   qRegisterMetaType<RecordList>("qrs::RecordList");
+   qRegisterMetaTypeStreamOperators<RecordList>("qrs::RecordList");
+   registered = true;
+}
+
+/**
+ * @return list of elements each converted with Record::toVariant
+ */
+QVariant RecordList::toVariant() const {
+   QVariantList res;
+   for (int row = 0; row < rows(); row++) {
+      Record rec(mFields);
+      rec.values() = mCells.mid(row*mColumns, mColumns);
+      res.append(rec.toVariant());
+   }
+   return QVariant(res);
+}
+
+const RecordList *RecordList::get(const QVariant &arg) {
+   if ( arg.userType() != qMetaTypeId<RecordList>() ) {
+      return 0;
+   }
+   return static_cast<const RecordList*>(arg.constData());
+}
+
+RecordReader::RecordReader(const QVariant &arg, const QStringList &fields):
+      mFields(&fields), mValues(0), mOffset(0), mCount(0) {
+   const Record *rec = Record::get(arg);
+   if ( rec != 0 ) {
+      mValues = &rec->values();
+      mCount = mValues->size();
+   } else {
+      mMap = arg.toMap();
+   }
+}
+
+RecordReader::RecordReader(const RecordList &list, int row):
+      mFields(list.fields()), mValues(&list.cells()),
+      mOffset(row*list.columns()), mCount(list.columns()) {
+}
+
+const QVariant *RecordReader::field(int index) const {
+   if ( mValues != 0 ) {
+      return index < mCount ? &mValues->at(mOffset + index) : 0;
+   }
+   if ( mFields == 0 || index >= mFields->size() ) {
+      return 0;
+   }
+   QVariantMap::const_iterator it = mMap.constFind(mFields->at(index));
+   return it == mMap.constEnd() ? 0 : &it.value();
+}
+
+QDataStream &qrs::operator<<(QDataStream &stream, const Record &rec) {
+   stream << rec.values();
+   return stream;
+}
+
+QDataStream &qrs::operator>>(QDataStream &stream, Record &rec) {
+   rec = Record();
+   stream >> rec.values();
+   return stream;
+}
+
+QDataStream &qrs::operator<<(QDataStream &stream, const RecordList &list) {
+   stream << quint32(list.columns()) << quint32(list.cells().size());
+   foreach (const QVariant &cell, list.cells()) {
+      stream << cell;
+   }
+   return stream;
+}
+
+QDataStream &qrs::operator>>(QDataStream &stream, RecordList &list) {
+   list = RecordList();
+   quint32 columns, count;
+   stream >> columns >> count;
+   if ( stream.status() != QDataStream::Ok ) {
+      return stream;
+   }
+   if ( columns > quint32(INT_MAX) || (columns == 0 && count != 0) ||
+        (columns != 0 && count % columns != 0) ) {
+      stream.setStatus(QDataStream::ReadCorruptData);
+      return stream;
+   }
+   for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+      QVariant cell;
+      stream >> cell;
+      list.mCells.append(cell);
+   }
+   list.mColumns = columns;
+   return stream;
+}
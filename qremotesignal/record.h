@@ -0,0 +1,122 @@
+/**
+ * @file record.h
+ * @brief Record and RecordList classes used by generated struct converters
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _Record_H
+#define _Record_H
+
+#include <QtCore/QDataStream>
+#include <QtCore/QList>
+#include <QtCore/QMetaType>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVariant>
+
+#include "qrsexport.h"
+
+namespace qrs {
+
+   /**
+    * @brief Positional representation of a structure declared in the
+    * interface XML.
+    *
+    * Converters generated by qrsc for @b struct elements put field values
+    * into the record in the order of declaration. Binary serializers write
+    * only the values so field names are never transferred. JsonSerializer
+    * turns the record into an object using field names so JSON messages stay
+    * human readable.
+    *
+    * Field names list is owned by the generated code and is shared by all
+    * records of the same structure. Records deserialized from the binary
+    * stream have no field names.
+    */
+   class QRS_EXPORT Record {
+      public:
+         Record(): mFields(0) {}
+         explicit Record(const QStringList *fields): mFields(fields) {}
+
+         const QStringList *fields() const {return mFields;}
+         QVariantList &values() {return mValues;}
+         const QVariantList &values() const {return mValues;}
+
+         QVariant toVariant() const;
+
+         /// @brief Record stored in the QVariant or 0 if it holds other type
+         static const Record *get(const QVariant &arg);
+
+         static void registerMetaTypes();
+
+      private:
+         const QStringList *mFields;
+         QVariantList mValues;
+   };
+
+   /**
+    * @brief Bulk representation of a list of structures.
+    *
+    * Values of all elements are stored in one row-major table. Binary
+    * serializers write number of columns and rows once followed by the values
+    * so there is neither a map nor a separate list per element.
+    */
+   class QRS_EXPORT RecordList {
+      public:
+         RecordList(): mFields(0), mColumns(0) {}
+         explicit RecordList(const QStringList *fields):
+            mFields(fields), mColumns(fields->size()) {}
+
+         const QStringList *fields() const {return mFields;}
+         int columns() const {return mColumns;}
+         int rows() const {return mColumns == 0 ? 0 : mCells.size() / mColumns;}
+         /// @brief Field values of all elements one element after another
+         QVariantList &cells() {return mCells;}
+         const QVariantList &cells() const {return mCells;}
+
+         QVariant toVariant() const;
+
+         /// @brief RecordList stored in the QVariant or 0 if it holds other type
+         static const RecordList *get(const QVariant &arg);
+
+      private:
+         friend QDataStream &operator>>(QDataStream &stream, RecordList &list);
+
+         const QStringList *mFields;
+         int mColumns;
+         QVariantList mCells;
+   };
+
+   /**
+    * @brief Field access used by the generated converters.
+    *
+    * Reads fields by position from Record or RecordList row and by name from
+    * QVariantMap (the form JSON objects are decoded to).
+    */
+   class QRS_EXPORT RecordReader {
+      public:
+         RecordReader(const QVariant &arg, const QStringList &fields);
+         RecordReader(const RecordList &list, int row);
+
+         /// @brief Value of the field or 0 if the field is absent
+         const QVariant *field(int index) const;
+
+      private:
+         const QStringList *mFields;
+         const QVariantList *mValues;
+         int mOffset;
+         int mCount;
+         QVariantMap mMap;
+   };
+
+   QRS_EXPORT QDataStream &operator<<(QDataStream &stream, const Record &rec);
+   QRS_EXPORT QDataStream &operator>>(QDataStream &stream, Record &rec);
+   QRS_EXPORT QDataStream &operator<<(QDataStream &stream, const RecordList &list);
+   QRS_EXPORT QDataStream &operator>>(QDataStream &stream, RecordList &list);
+
+}
+
+Q_DECLARE_METATYPE(qrs::Record);
+Q_DECLARE_METATYPE(qrs::RecordList);
+
+#endif
@@ -8,27 +8,254 @@
 #include "servicesmanager.h"
 
 #include <QtCore/QPointer>
+#include <QtCore/QThread>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QWeakPointer>
 #include <QtCore/QMap>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
 #include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QReadLocker>
 #include <QtCore/QWriteLocker>
+#include <QtCore/QtEndian>
+#if QT_VERSION >= 0x050000
+#include <QtCore/QMetaMethod>
+#endif
+#include <QtNetwork/QUdpSocket>
 
 #include "qdatastreamserializer.h"
+#include "jsonserializer.h"
 #include "devicemanager.h"
+#include "bufferpool.h"
+#include "tokenbucket.h"
+#include "traffic.h"
+#include "threaddispatcher.h"
 #include "absmessageserializer.h"
 #include "absservice.h"
+#include "baseconverters.h"
 
 namespace qrs {
 namespace internals {
 
+// Payload prefixes of the HelloFrame control frames
+static const char OFFER[] = "offer:";
+static const char SELECT[] = "select:";
+static const char SWITCH[] = "switch";
+
+// Reserved method names of the subscription requests. Dots are not allowed
+// in the method names of the interface description so they can't clash.
+static const char SUBSCRIBE[] = "qrs.subscribe";
+static const char UNSUBSCRIBE[] = "qrs.unsubscribe";
+/// Maximum number of distinct filters the peer can subscribe with per signal
+static const int MAX_FILTERS = 32;
+
+/// Filters by signal name. Empty filter matches every emission.
+typedef QHash< QString, QList<QVariantMap> > SignalFilters;
+
+/// Rate limit of the service or method set with ServicesManager::setRateLimit
+struct RateLimit {
+    double rate;
+    int burst;
+    ServicesManager::RateLimitAction action;
+};
+/// Rate limits by service and method name. Empty method limits the service.
+typedef QHash< QString, QHash<QString, RateLimit> > RateLimits;
+
+/**
+ * @internal
+ *
+ * State of one device added with ServicesManager::addDevice. Serializers are
+ * 0 until the wire format is negotiated which means the manager serializer
+ * is used. Each direction switches to the negotiated serializer at the point
+ * marked in the stream by the HelloFrame sent by the peer switching.
+ */
+class Connection {
+public:
+    Connection(DeviceManager *dm, QIODevice *dev):
+        mDevManager(dm), mDevice(dev), mChannel(0), mInSerializer(0),
+        mOutSerializer(0), mId(0) {}
+    Connection(const QSharedPointer<DeviceManager> &dm, QIODevice *dev,
+               int channel):
+        mDevManager(dm), mDevice(dev), mChannel(channel), mInSerializer(0),
+        mOutSerializer(0), mId(0) {}
+
+    /// Shared by the managers using different channels of the device
+    QSharedPointer<DeviceManager> mDevManager;
+    /// Used as index key only. Device can be already deleted.
+    QIODevice *mDevice;
+    /// Logical channel of the device used by this manager
+    int mChannel;
+    /// OFFER payload sent to the peer or empty array
+    QByteArray mOffer;
+    AbsMessageSerializer *mInSerializer;
+    AbsMessageSerializer *mOutSerializer;
+    /// Device id written to the traffic record
+    quint32 mId;
+    /// Groups this connection is member of
+    QSet<QString> mGroups;
+    /**
+     * Signals subscribed by the peer by service name. Peer receives all
+     * signals of the services it never subscribed to.
+     */
+    QHash<QString, SignalFilters> mSubscriptions;
+    /// Rate limit buckets by service and method name like the limits
+    QHash< QString, QHash<QString, TokenBucket> > mBuckets;
+
+    bool accepts(const Message &msg) const {
+        if ( mSubscriptions.isEmpty() ) {
+            return true;
+        }
+        QHash<QString, SignalFilters>::const_iterator service =
+            mSubscriptions.constFind(msg.service());
+        if ( service == mSubscriptions.constEnd() ) {
+            return true;
+        }
+        SignalFilters::const_iterator filters = service->constFind(msg.method());
+        if ( filters == service->constEnd() ) {
+            return false;
+        }
+        foreach (const QVariantMap &filter, filters.value()) {
+            bool match = true;
+            QVariantMap::const_iterator it;
+            for ( it = filter.constBegin(); match && it != filter.constEnd(); ++it ) {
+                QVariantMap::const_iterator param = msg.params().constFind(it.key());
+                match = param != msg.params().constEnd() && param.value() == it.value();
+            }
+            if ( match ) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Device managers of the devices added with ServicesManager::addChannel by
+ * device. Entries of the deleted managers are removed on next insertion.
+ */
+static QMutex channelDevicesMutex;
+static QHash< QIODevice*, QWeakPointer<DeviceManager> > channelDevices;
+
 class ServicesManagerPrivate {
 public:
+    ServicesManager *q;
     QMap< QString, AbsService*> mServices;
-    QList< QSharedPointer<DeviceManager> > mDevManagers;
+    QList< QSharedPointer<Connection> > mConnections;
+    QHash<DeviceManager*, Connection*> mConnectionsIndex;
+    QHash<QIODevice*, Connection*> mDevicesIndex;
+    QHash< QString, QSet<Connection*> > mGroups;
+    /// Group name by "service::signal" key
+    QHash<QString, QString> mSignalGroups;
     QPointer<AbsMessageSerializer> mSerializer;
+    QList<AbsMessageSerializer*> mSupportedSerializers;
+    bool mProtocolNegotiation;
     quint32 mMessageSizeLimit;
+    int mKeepAliveInterval;
+    int mKeepAliveTimeout;
+    int mReadBudgetFrames;
+    int mReadBudgetBytes;
+    int mDatagramSize;
+    double mRate;
+    int mBurst;
+    ServicesManager::RateLimitAction mRateLimitAction;
+    RateLimits mRateLimits;
+    TrafficRecorder *mRecorder;
+    quint32 mLastDeviceId;
+    bool mThreadDispatch;
+    /// Manager linked with setLoopbackPeer
+    QPointer<ServicesManager> mLoopbackPeer;
+    bool mLoopbackSerialization;
+    /// Dispatchers of the service threads used by this manager
+    QHash< QThread*, QPointer<ThreadDispatcher> > mDispatchers;
+
+    QSharedPointer<Connection> takeConnection(int i) {
+        QSharedPointer<Connection> res = mConnections.takeAt(i);
+        // Device manager outlives the connection if other managers share it
+        QObject::disconnect(res->mDevManager.data(), 0, q, 0);
+        mConnectionsIndex.remove(res->mDevManager.data());
+        mDevicesIndex.remove(res->mDevice);
+        foreach (const QString &group, res->mGroups) {
+            QHash< QString, QSet<Connection*> >::iterator it = mGroups.find(group);
+            it.value().remove(res.data());
+            if ( it.value().isEmpty() ) {
+                mGroups.erase(it);
+            }
+        }
+        return res;
+    }
+
+    AbsMessageSerializer *supported(const QByteArray &id) const {
+        foreach (AbsMessageSerializer *serializer, mSupportedSerializers) {
+            if ( !id.isEmpty() && serializer->protocolId() == id ) {
+                return serializer;
+            }
+        }
+        return 0;
+    }
+
+    ThreadDispatcher *dispatcher(QThread *thread) {
+        QPointer<ThreadDispatcher> &res = mDispatchers[thread];
+        if ( !res ) {
+            res = ThreadDispatcher::forThread(thread);
+        }
+        return res;
+    }
+
+    /// Sends frame to the connection device recording the message if needed
+    void transmit(Connection *conn, const QByteArray &frame) {
+        if ( mRecorder != 0 ) {
+            mRecorder->record(TrafficRecorder::Sent, conn->mId, payload(frame));
+        }
+        conn->mDevManager->sendFrame(frame, conn->mChannel);
+    }
+
+    /**
+     * Serializes message into the frame prefixed with the message size
+     * caching results per serializer. Size is the same for every stream
+     * device so the frame is written to all of them as is.
+     */
+    QByteArray frame(AbsMessageSerializer *serializer, const Message &msg,
+                     QHash<AbsMessageSerializer*, QByteArray> &cache) {
+        QHash<AbsMessageSerializer*, QByteArray>::iterator it = cache.find(serializer);
+        if ( it == cache.end() ) {
+            QByteArray res = serializer->serializeAt(msg, DeviceManager::FRAME_HEADER);
+            qToBigEndian<quint32>(res.size() - DeviceManager::FRAME_HEADER,
+                                  reinterpret_cast<uchar*>(res.data()));
+            it = cache.insert(serializer, res);
+        }
+        return it.value();
+    }
+
+    /// Frame of the message for the connection
+    QByteArray encode(Connection *conn, const Message &msg,
+                      QHash<AbsMessageSerializer*, QByteArray> &cache) {
+        AbsMessageSerializer *serializer = conn->mOutSerializer;
+        if ( serializer == 0 ) {
+            serializer = mSerializer;
+        }
+        return frame(serializer, msg, cache);
+    }
+
+    /// Message of the frame. Valid while the frame is alive.
+    static QByteArray payload(const QByteArray &frame) {
+        return QByteArray::fromRawData(frame.constData() + DeviceManager::FRAME_HEADER,
+                                       frame.size() - DeviceManager::FRAME_HEADER);
+    }
+
+    /**
+     * Gives frames built by frame() back to the buffer pool. Frames queued
+     * by the devices are still referenced and are not recycled.
+     */
+    void recycle(QHash<AbsMessageSerializer*, QByteArray> &cache) {
+        BufferPool *pool = BufferPool::local();
+        QHash<AbsMessageSerializer*, QByteArray>::iterator it;
+        for ( it = cache.begin(); it != cache.end(); ++it ) {
+            pool->release(it.value());
+        }
+    }
 };
 
 }
@@ -85,7 +312,31 @@ ServicesManager::ServicesManager(QObject *parent):
         QObject(parent),
         d(new internals::ServicesManagerPrivate)
 {
+    d->q = this;
     d->mMessageSizeLimit = 0;
+    d->mKeepAliveInterval = 0;
+    d->mKeepAliveTimeout = 0;
+    d->mReadBudgetFrames = 0;
+    d->mReadBudgetBytes = 0;
+    d->mDatagramSize = internals::DeviceManager::DEFAULT_DATAGRAM_SIZE;
+    d->mRate = 0;
+    d->mBurst = 0;
+    d->mRateLimitAction = DropMessages;
+    d->mRecorder = 0;
+    d->mLastDeviceId = 0;
+    d->mThreadDispatch = false;
+    d->mLoopbackSerialization = false;
+    d->mProtocolNegotiation = false;
+    // Preferred formats go first
+    d->mSupportedSerializers << qDataStreamSerializer_4_5
+                             << qDataStreamSerializer_4_4
+                             << qDataStreamSerializer_4_3
+                             << qDataStreamSerializer_4_2
+                             << qDataStreamSerializer_4_1
+                             << qDataStreamSerializer_4_0
+                             << jsonSerializer;
+    // Needed for the queued peerTimeout connection
+    qRegisterMetaType<internals::DeviceManager *>("qrs::internals::DeviceManager*");
     QReadLocker locker(&defaultSerializerLocker);
     if ( mDefaultSerializer == 0 ) {
         d->mSerializer = qDataStreamSerializer_4_5;
@@ -96,6 +347,7 @@ ServicesManager::ServicesManager(QObject *parent):
 
 ServicesManager::~ServicesManager()
 {
+    setLoopbackPeer(0);
     delete d;
 }
 
@@ -124,7 +376,7 @@ void ServicesManager::setSerializer(AbsMessageSerializer *serializer)
 
 int ServicesManager::devicesCount() const
 {
-    return d->mDevManagers.count();
+    return d->mConnections.count();
 }
 
 /**
@@ -133,7 +385,7 @@ int ServicesManager::devicesCount() const
  */
 QIODevice *ServicesManager::deviceAt(int i)
 {
-    return d->mDevManagers[i]->device();
+    return d->mConnections[i]->mDevManager->device();
 }
 
 /**
@@ -146,7 +398,7 @@ QIODevice *ServicesManager::deviceAt(int i)
  */
 void ServicesManager::removeDevice(int i)
 {
-    d->mDevManagers.removeAt(i);
+    d->takeConnection(i);
 }
 
 /**
@@ -159,7 +411,7 @@ void ServicesManager::removeDevice(int i)
  */
 QIODevice *ServicesManager::takeDeviceAt(int i)
 {
-    return d->mDevManagers.takeAt(i)->device();
+    return d->takeConnection(i)->mDevManager->device();
 }
 
 /**
@@ -181,53 +433,215 @@ QIODevice *ServicesManager::takeDeviceAt(int i)
  * @sa AbsMessageSerializer
  *
  * @param msg received raw message
+ *
+ * Calls collected by services for batch signals are delivered before this
+ * slot returns.
+ *
+ * @return status of the message processing. Errors are reported without
+ * exceptions and error description is formatted only when error reply is
+ * sent.
  */
-void ServicesManager::receive(const QByteArray& msg)
+Status ServicesManager::receive(const QByteArray& msg)
 {
-    if ( !d->mSerializer ) {
-        return;
+    Status status = process(0, msg);
+    flushBatches();
+    return status;
+}
+
+/**
+ * @internal
+ *
+ * Processes raw message received from the device managed by @a source or
+ * passed to the receive(const QByteArray&) slot if @a source is 0.
+ */
+Status ServicesManager::process(internals::DeviceManager *source,
+                                const QByteArray& msg)
+{
+    AbsMessageSerializer *serializer = d->mSerializer;
+    internals::Connection *conn = 0;
+    if ( source != 0 ) {
+        conn = d->mConnectionsIndex.value(source, 0);
+        if ( conn == 0 ) {
+            return Status();
+        }
+        if ( conn->mInSerializer != 0 ) {
+            serializer = conn->mInSerializer;
+        }
     }
-    MessageAP message;
-    try {
-        message = d->mSerializer->deserialize(msg);
-    } catch (const MessageParsingException& e) {
-        Message err;
-        err.setType(Message::Error);
-        err.setErrorType(e.mErrorType);
-        err.setError( e.reason() );
-        emit send( d->mSerializer->serialize(err) );
-        emit clientError(this, err.errorType(), err.error());
-        return;
+    if ( d->mRecorder != 0 ) {
+        d->mRecorder->record(TrafficRecorder::Received,
+                             conn != 0 ? conn->mId : 0, msg);
+    }
+    if ( serializer == 0 ) {
+        return Status();
+    }
+    AbsMessageSerializer *selected = serializer->select(msg);
+    if ( selected != 0 && selected != serializer ) {
+        serializer = selected;
+        // Replies and signals go in the format the peer used
+        if ( conn != 0 ) {
+            conn->mOutSerializer = selected;
+        }
+    }
+    Status status;
+    MessageAP message = serializer->deserialize(msg, status);
+    if ( !status.isOk() ) {
+        sendError(source, status);
+        return status;
     }
+    return dispatch(source, conn, message);
+}
+
+/**
+ * @internal
+ *
+ * Delivers decoded message to the service. Message is moved to the service
+ * thread if thread dispatch is enabled.
+ */
+Status ServicesManager::dispatch(internals::DeviceManager *source,
+                                 internals::Connection *conn,
+                                 MessageAP message)
+{
+    Status status;
     if ( message->type() == Message::Error ) {
         emit error(this, message->errorType(), message->error());
-        return;
+        return status;
+    }
+    if ( conn != 0 && !d->mRateLimits.isEmpty() && !admit(conn, *message) ) {
+        return status;
     }
     QMap<QString,AbsService*>::iterator res = d->mServices.find(message->service());
+    if ( res != d->mServices.end() &&
+         (message->method() == internals::SUBSCRIBE ||
+          message->method() == internals::UNSUBSCRIBE) ) {
+        if ( conn == 0 ) {
+            // Messages passing through receive() or the loopback link have
+            // no peer to filter signals for
+            status = Status(Message::IncorrectMethod,
+                            "Subscriptions are supported for devices only");
+        } else if ( message->method() == internals::SUBSCRIBE ) {
+            QString signal = message->params().value("signal").toString();
+            const QVariantMap filter = message->params().value("filter").toMap();
+            QList<QVariantMap> &filters = conn->mSubscriptions[message->service()][signal];
+            // Repeated subscription replaces the same filter
+            if ( !filters.contains(filter) ) {
+                if ( filters.size() < internals::MAX_FILTERS ) {
+                    filters.append(filter);
+                } else {
+                    status = Status(Message::IncorrectMethod,
+                                    "Too many filters for signal \"%1\"", signal);
+                }
+            }
+        } else {
+            // Service stays filtered for the peer
+            QString signal = message->params().value("signal").toString();
+            conn->mSubscriptions[message->service()].remove(signal);
+        }
+        if ( !status.isOk() ) {
+            sendError(source, status, message->service(), message->method());
+        }
+        return status;
+    }
+    if ( res != d->mServices.end() && d->mThreadDispatch &&
+         (*res)->thread() != thread() ) {
+        // Message is moved to the service thread. Errors are replied by
+        // onDispatchError.
+        internals::DispatchItem *item = new internals::DispatchItem;
+        item->service = *res;
+        item->manager = this;
+        item->source = source;
+        item->msg = message.release();
+        d->dispatcher((*res)->thread())->post(item);
+        return status;
+    }
     if ( res != d->mServices.end() ) {
-        try {
-            (*res)->processMessage(*message);
-        } catch ( IncorrectMethodException& e ) {
-            Message err;
-            err.setType(Message::Error);
-            err.setErrorType(Message::IncorrectMethod);
-            err.setError(e.reason());
-            err.setService(message->service());
-            err.setMethod(message->method());
-            emit send( d->mSerializer->serialize(err) );
-            emit clientError(this, err.errorType(), err.error());
-            return;
+        (*res)->processMessage(*message, status);
+    } else {
+        status = Status(Message::UnknownService, "Unknown service: \"%1\"",
+                        message->service());
+    }
+    if ( !status.isOk() ) {
+        sendError(source, status, message->service(), message->method());
+    }
+    return status;
+}
+
+/**
+ * @internal
+ *
+ * Takes tokens from the connection buckets of the method and service rate
+ * limits applying the limit action if there are no tokens.
+ *
+ * @return false if message should be dropped.
+ */
+bool ServicesManager::admit(internals::Connection *conn, const Message &msg)
+{
+    internals::RateLimits::const_iterator limits =
+        d->mRateLimits.constFind(msg.service());
+    if ( limits == d->mRateLimits.constEnd() ) {
+        return true;
+    }
+    // Names are shared with the message so no strings are allocated
+    const QString methods[2] = {msg.method(), QString()};
+    for ( int i = 0; i < 2; i++ ) {
+        QHash<QString, internals::RateLimit>::const_iterator limit =
+            limits->constFind(methods[i]);
+        if ( limit == limits->constEnd() ) {
+            continue;
+        }
+        QHash<QString, internals::TokenBucket> &buckets =
+            conn->mBuckets[msg.service()];
+        QHash<QString, internals::TokenBucket>::iterator bucket =
+            buckets.find(methods[i]);
+        if ( bucket == buckets.end() ) {
+            bucket = buckets.insert(methods[i], internals::TokenBucket());
+            bucket->setLimit(limit->rate, limit->burst);
+        }
+        bool delay = limit->action == DelayReading;
+        if ( bucket->take(delay) ) {
+            continue;
         }
+        QIODevice *dev = conn->mDevManager->device();
+        if ( delay ) {
+            conn->mDevManager->pauseReading(bucket->waitTime());
+        } else if ( limit->action == CloseDevice && dev != 0 ) {
+            dev->close();
+        }
+        emit rateLimitExceeded(dev);
+        return delay;
+    }
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Replies with error message to the device managed by @a source only. If
+ * @a source is 0 error message is sent the same way as any other message.
+ */
+void ServicesManager::sendError(internals::DeviceManager *source,
+                                const Status &status,
+                                const QString &service,
+                                const QString &method)
+{
+    Message err;
+    err.setType(Message::Error);
+    err.setErrorType(status.code());
+    err.setError(status.detail());
+    err.setService(service);
+    err.setMethod(method);
+    if ( source == 0 ) {
+        send(err);
     } else {
-        Message err;
-        err.setType(Message::Error);
-        err.setErrorType(Message::UnknownService);
-        err.setError(QString("Unknown service: \"%1\"").arg(message->service()));
-        err.setService(message->service());
-        emit send( d->mSerializer->serialize(err) );
-        emit clientError(this, err.errorType(), err.error());
-        return;
+        // Service could remove the device while processing the message
+        internals::Connection *conn = d->mConnectionsIndex.value(source, 0);
+        if ( conn != 0 && (conn->mOutSerializer != 0 || d->mSerializer) ) {
+            QHash<AbsMessageSerializer*, QByteArray> cache;
+            d->transmit( conn, d->encode(conn, err, cache) );
+            d->recycle(cache);
+        }
     }
+    emit clientError(this, err.errorType(), err.error());
 }
 
 /**
@@ -313,8 +727,59 @@ AbsService *ServicesManager::service(const QString &name)
  */
 void ServicesManager::send(const Message& msg)
 {
+    if ( d->mLoopbackPeer ) {
+        loopback(msg);
+    }
     if ( !d->mSerializer ) return;
-    emit send( d->mSerializer->serialize(msg) );
+    if ( !d->mSignalGroups.isEmpty() ) {
+        QHash<QString, QString>::const_iterator route =
+            d->mSignalGroups.constFind(msg.service() + "::" + msg.method());
+        if ( route != d->mSignalGroups.constEnd() ) {
+            publish(route.value(), msg);
+            return;
+        }
+    }
+    // Message is serialized only once per distinct serializer in use and
+    // only if somebody is going to get it.
+    QHash<AbsMessageSerializer*, QByteArray> cache;
+    if ( receivers(SIGNAL(send(QByteArray))) > 0 ) {
+        // Receivers may keep the message so it's copied out of the frame
+        const QByteArray raw = d->frame(d->mSerializer, msg, cache)
+                                   .mid(internals::DeviceManager::FRAME_HEADER);
+        if ( d->mRecorder != 0 ) {
+            d->mRecorder->record(TrafficRecorder::Sent, 0, raw);
+        }
+        emit send(raw);
+    }
+    foreach (const QSharedPointer<internals::Connection> conn, d->mConnections) {
+        if ( conn->accepts(msg) ) {
+            d->transmit( conn.data(), d->encode(conn.data(), msg, cache) );
+        }
+    }
+    d->recycle(cache);
+}
+
+/**
+ * @internal
+ *
+ * Used by the generated classes to skip building and serializing of the
+ * message nobody is going to get. Devices are checked first so the signal
+ * connections are looked up only by the managers without devices.
+ *
+ * @return false if there is no loopback peer, no serializer, no devices and
+ * nothing is connected to the send(QByteArray) signal.
+ */
+bool ServicesManager::hasConsumers() const
+{
+    if ( d->mLoopbackPeer ) return true;
+    if ( !d->mSerializer ) return false;
+    if ( !d->mConnections.isEmpty() ) return true;
+#if QT_VERSION >= 0x050000
+    static const QMetaMethod sendSignal = QMetaMethod::fromSignal(&ServicesManager::send);
+    return isSignalConnected(sendSignal);
+#else
+    return receivers(SIGNAL(send(QByteArray))) > 0;
+#endif
 }
 
 /**
@@ -332,21 +797,150 @@ void ServicesManager::send(const Message& msg)
  */
 void ServicesManager::addDevice(QIODevice *dev)
 {
-    foreach (const QSharedPointer<internals::DeviceManager> dm, d->mDevManagers) {
-        if ( dm->device() == dev ) {
-            return;
+    addDevice(dev, 0);
+}
+
+/**
+ * Adds device which messages are protected with the @a transport. Manager
+ * takes ownership of the @a transport which is deleted when the device is
+ * removed. Each device needs its own transport instance. The @a transport
+ * is deleted immediately if the device is already added.
+ *
+ * @code
+ * manager->addDevice(socket, new MyTransport(settings));
+ * @endcode
+ *
+ * @sa addDevice(QIODevice *)
+ * @sa transportError
+ */
+void ServicesManager::addDevice(QIODevice *dev, AbsTransport *transport)
+{
+    if ( d->mDevicesIndex.contains(dev) ) {
+        delete transport;
+        return;
+    }
+    QSharedPointer<internals::Connection> conn(
+        new internals::Connection(new internals::DeviceManager(), dev)
+    );
+    attach(conn, transport, true);
+}
+
+/**
+ * Adds the @a channel of the device shared by several managers. Each
+ * manager using the device gets messages sent by the peer to its channel
+ * only while the frames of all channels are read by one device manager:
+ * @code
+ * quotesManager->addChannel(socket, 1);
+ * ordersManager->addChannel(socket, 2);
+ * @endcode
+ * Peer attaches its managers to the same channel numbers of its socket.
+ * Switching channel costs four bytes and only when the frame sent belongs
+ * to other channel than the previous one. Channel 0 is the same as the
+ * device added with addDevice(QIODevice *) by the peer. Channels other than
+ * 0 require the peer to use this or later version of the library: older
+ * versions take channel selectors for sizes of huge messages.
+ *
+ * Device is read with the settings (message size limit, keep-alive, rate
+ * limit and so on) of the manager which added it first. Messages sent to
+ * the channel before any manager added it are dropped. All managers
+ * sharing the device should live in the same thread. Channels of the
+ * datagram devices are not supported.
+ *
+ * @return false if the device is already added to this manager, @a channel
+ * is not in the range from 0 to 239 or device is QUdpSocket and @a channel
+ * is not 0.
+ *
+ * @sa addDevice(QIODevice *)
+ */
+bool ServicesManager::addChannel(QIODevice *dev, int channel)
+{
+    if ( d->mDevicesIndex.contains(dev) ||
+         channel < 0 || channel > internals::DeviceManager::MAX_CHANNEL ) {
+        return false;
+    }
+    if ( channel != 0 && qobject_cast<QUdpSocket*>(dev) != 0 ) {
+        return false;
+    }
+    QSharedPointer<internals::DeviceManager> dm;
+    {
+        QMutexLocker locker(&internals::channelDevicesMutex);
+        dm = internals::channelDevices.value(dev).toStrongRef();
+        if ( dm.isNull() || dm->device() != dev ) {
+            QMutableHashIterator< QIODevice*, QWeakPointer<internals::DeviceManager> >
+                it(internals::channelDevices);
+            while ( it.hasNext() ) {
+                if ( it.next().value().isNull() ) {
+                    it.remove();
+                }
+            }
+            dm = QSharedPointer<internals::DeviceManager>(new internals::DeviceManager());
+            internals::channelDevices.insert(dev, dm);
         }
     }
-    QSharedPointer<internals::DeviceManager> dm(new internals::DeviceManager());
-    dm->setMaxMessageSize(d->mMessageSizeLimit);
-    connect( dm.data(), SIGNAL(received(QByteArray)),
-             this, SLOT(receive(const QByteArray&)) );
-    connect( this, SIGNAL(send(QByteArray)),
-             dm.data(), SLOT(send(const QByteArray&)) );
-    connect( dm.data(), SIGNAL(messageTooBig(qrs::internals::DeviceManager *)),
+    // Device is not set yet only if the manager was just created
+    const bool created = dm->device() == 0;
+    QSharedPointer<internals::Connection> conn(
+        new internals::Connection(dm, dev, channel)
+    );
+    attach(conn, 0, created);
+    return true;
+}
+
+/**
+ * Connects device manager of the new connection. If @a configure is set
+ * device manager gets settings of this manager and starts reading the
+ * device.
+ */
+void ServicesManager::attach(const QSharedPointer<internals::Connection> &conn,
+                             AbsTransport *transport, bool configure)
+{
+    QIODevice *dev = conn->mDevice;
+    conn->mId = ++d->mLastDeviceId;
+    internals::DeviceManager *dm = conn->mDevManager.data();
+    connect( dm, SIGNAL(received(QByteArray)),
+             this, SLOT(onDeviceReceived(const QByteArray&)) );
+    connect( dm, SIGNAL(controlFrameReceived(qrs::internals::DeviceManager *, quint32, QByteArray)),
+             this, SLOT(onControlFrame(qrs::internals::DeviceManager *, quint32, const QByteArray &)) );
+    connect( dm, SIGNAL(messageTooBig(qrs::internals::DeviceManager *)),
              this, SLOT(onMessageTooBig(qrs::internals::DeviceManager *)) );
-    dm->setDevice(dev);
-    d->mDevManagers.append(dm);
+    // Queued since the device manager is destroyed by the slot
+    connect( dm, SIGNAL(peerTimeout(qrs::internals::DeviceManager *)),
+             this, SLOT(onPeerTimeout(qrs::internals::DeviceManager *)),
+             Qt::QueuedConnection );
+    connect( dm, SIGNAL(rateLimitExceeded(qrs::internals::DeviceManager *)),
+             this, SLOT(onRateLimitExceeded(qrs::internals::DeviceManager *)) );
+    connect( dm, SIGNAL(readPassFinished(qrs::internals::DeviceManager *)),
+             this, SLOT(onReadPassFinished(qrs::internals::DeviceManager *)) );
+    connect( dm, SIGNAL(transportError(qrs::internals::DeviceManager *)),
+             this, SLOT(onTransportError(qrs::internals::DeviceManager *)) );
+    if ( configure ) {
+        dm->setMaxMessageSize(d->mMessageSizeLimit);
+        dm->setTransport(transport);
+        dm->setKeepAlive(d->mKeepAliveInterval, d->mKeepAliveTimeout);
+        dm->setRateLimit(d->mRate, d->mBurst, d->mRateLimitAction == DelayReading);
+        dm->setReadBudget(d->mReadBudgetFrames, d->mReadBudgetBytes);
+        dm->setDatagramSize(d->mDatagramSize);
+        dm->setDevice(dev);
+    }
+    d->mConnections.append(conn);
+    d->mConnectionsIndex.insert(dm, conn.data());
+    d->mDevicesIndex.insert(dev, conn.data());
+    if ( d->mProtocolNegotiation ) {
+        QList<QByteArray> offer;
+        foreach (AbsMessageSerializer *serializer, d->mSupportedSerializers) {
+            if ( !serializer->protocolId().isEmpty() ) {
+                offer.append(serializer->protocolId());
+            }
+        }
+        QByteArray payload(OFFER);
+        for (int i = 0; i < offer.size(); i++) {
+            if ( i > 0 ) payload += ',';
+            payload += offer[i];
+        }
+        dm->sendControlFrame(internals::DeviceManager::HelloFrame, payload,
+                             conn->mChannel);
+        conn->mOffer = payload;
+    }
     connect( dev, SIGNAL(destroyed( QObject* )),
              this, SLOT(onDeviceDeleted(QObject*)) );
 }
@@ -386,8 +980,698 @@ quint32 ServicesManager::messageSizeLimit() const
 void ServicesManager::setMessageSizeLimit(quint32 val)
 {
     d->mMessageSizeLimit = val;
-    foreach(QSharedPointer<internals::DeviceManager> dm, d->mDevManagers) {
-        dm->setMaxMessageSize(val);
+    foreach(QSharedPointer<internals::Connection> conn, d->mConnections) {
+        conn->mDevManager->setMaxMessageSize(val);
+    }
+}
+
+/**
+ * @return current keep-alive ping interval in milliseconds.
+ * @sa setKeepAlive(int, int)
+ */
+int ServicesManager::keepAliveInterval() const
+{
+    return d->mKeepAliveInterval;
+}
+
+/**
+ * @return current keep-alive timeout in milliseconds.
+ * @sa setKeepAlive(int, int)
+ */
+int ServicesManager::keepAliveTimeout() const
+{
+    return d->mKeepAliveTimeout;
+}
+
+/**
+ * Half-open connections (for example TCP connection to the host which was
+ * powered off) are not reported by the device until some data is written to
+ * it and may stay alive for a long time. This function enables built-in
+ * keep-alive for all devices added with addDevice(QIODevice*) method.
+ *
+ * If nothing was sent to a device during @a interval milliseconds a tiny
+ * control frame (four bytes) is sent to it and the peer replies with the same
+ * sized frame. If nothing was received from the device during @a timeout
+ * milliseconds the device is closed, removed from the list of devices used
+ * by this manager and peerTimeout(QIODevice *) signal is emitted.
+ *
+ * Pass 0 as @a interval to disable pings and 0 as @a timeout to disable dead
+ * peers detection. Both are disabled by default. It's reasonable to set
+ * timeout to several ping intervals.
+ *
+ * All devices of all managers living in the same thread are checked by one
+ * shared timer with resolution 100 milliseconds so there is no timer per
+ * device.
+ *
+ * @note Control frames are skipped by the QRemoteSignal versions before
+ * 1.4.0 but they don't reply to pings. Enable timeout for such peers only if
+ * they send messages often enough.
+ *
+ * @sa peerTimeout(QIODevice *)
+ */
+void ServicesManager::setKeepAlive(int interval, int timeout)
+{
+    d->mKeepAliveInterval = interval;
+    d->mKeepAliveTimeout = timeout;
+    foreach(QSharedPointer<internals::Connection> conn, d->mConnections) {
+        conn->mDevManager->setKeepAlive(interval, timeout);
+    }
+}
+
+/**
+ * By default all the messages available are read from a device before the
+ * control returns to the event loop. A single peer sending messages faster
+ * then they are processed can delay messages from all the other peers
+ * handled by the same thread in this case.
+ *
+ * This function limits amount of data read from each device added with
+ * addDevice(QIODevice*) method at once. Devices which have used up their
+ * budget continue reading in a round-robin order after the event loop
+ * processes notifications from the other devices. Both limits are checked
+ * between messages. Pass 0 to disable the limit. Both are disabled by
+ * default.
+ *
+ * @param frames maximum number of messages read from a device at once.
+ * @param bytes maximum number of bytes read from a device at once.
+ */
+void ServicesManager::setReadBudget(int frames, int bytes)
+{
+    d->mReadBudgetFrames = frames;
+    d->mReadBudgetBytes = bytes;
+    foreach(QSharedPointer<internals::Connection> conn, d->mConnections) {
+        conn->mDevManager->setReadBudget(frames, bytes);
+    }
+}
+
+/**
+ * @sa setReadBudget(int, int)
+ */
+int ServicesManager::readBudgetFrames() const
+{
+    return d->mReadBudgetFrames;
+}
+
+/**
+ * @sa setReadBudget(int, int)
+ */
+int ServicesManager::readBudgetBytes() const
+{
+    return d->mReadBudgetBytes;
+}
+
+/**
+ * Connected QUdpSocket added with addDevice(QIODevice*) method exchanges
+ * messages as datagrams. Single message is sent without length prefix while
+ * messages sent during one event loop iteration are packed together into
+ * datagrams not exceeding this size. Message which doesn't fit into a
+ * datagram alone is dropped and counted in DatagramStats::sendDropped.
+ * Default value is 1472 bytes which fits into one Ethernet frame.
+ *
+ * Datagrams are not retransmitted. Use this mode for the messages which are
+ * useless when late (telemetry, quotes and so on).
+ *
+ * @sa datagramStats(QIODevice *)
+ */
+void ServicesManager::setDatagramSize(int size)
+{
+    d->mDatagramSize = size;
+    foreach(QSharedPointer<internals::Connection> conn, d->mConnections) {
+        conn->mDevManager->setDatagramSize(size);
+    }
+}
+
+/**
+ * @sa setDatagramSize(int)
+ */
+int ServicesManager::datagramSize() const
+{
+    return d->mDatagramSize;
+}
+
+/**
+ * @return counters of the QUdpSocket added with addDevice(QIODevice*)
+ * method. All counters are zero for the other devices.
+ */
+DatagramStats ServicesManager::datagramStats(QIODevice *dev) const
+{
+    internals::Connection *conn = d->mDevicesIndex.value(dev, 0);
+    if ( conn == 0 ) {
+        return DatagramStats();
+    }
+    return conn->mDevManager->datagramStats();
+}
+
+/**
+ * Frames read from the devices and messages serialized with
+ * QDataStreamSerializer use byte arrays taken from the pool of the thread
+ * and given back once they are processed or sent. High miss rate means
+ * receivers keep references to the messages or messages are too big to be
+ * pooled.
+ */
+BufferPoolStats ServicesManager::bufferPoolStats()
+{
+    return internals::BufferPool::local()->stats();
+}
+
+/**
+ * By default services are called in the thread of the manager. If a service
+ * lives in other thread its signals are delivered to the receivers in that
+ * thread with queued connections copying all the arguments once again.
+ *
+ * If thread dispatch is enabled decoded messages for such services are
+ * moved to the lock-free queue of the service thread without copying and
+ * the service processes them in its own thread emitting signals directly.
+ * Each thread has one queue shared by all the managers posting to it.
+ * Errors are replied from the manager thread after the service reports
+ * them so the reply can be sent after the following messages are processed.
+ *
+ * @note Thread of the service should run an event loop and outlive
+ * registration of the service in the manager.
+ */
+void ServicesManager::setThreadDispatch(bool enabled)
+{
+    d->mThreadDispatch = enabled;
+}
+
+/**
+ * @sa setThreadDispatch(bool)
+ */
+bool ServicesManager::threadDispatch() const
+{
+    return d->mThreadDispatch;
+}
+
+/**
+ * Links this manager with the @a peer manager living in the same thread
+ * so every message sent by one of them is processed by the other one right
+ * in the send(const Message &) call. Messages are passed as is without
+ * serialization, framing or any device involved which makes it the cheapest
+ * way to connect co-located components and to test services without
+ * sockets. Messages are still sent to the devices of the manager as usual.
+ *
+ * Link is symmetric. Previous peers of both managers are unlinked. Passing
+ * 0 unlinks this manager. Link is removed automatically if one of the
+ * managers is deleted.
+ *
+ * @sa setLoopbackSerialization(bool)
+ */
+void ServicesManager::setLoopbackPeer(ServicesManager *peer)
+{
+    if ( peer == this ) {
+        return;
+    }
+    if ( d->mLoopbackPeer ) {
+        d->mLoopbackPeer->d->mLoopbackPeer = 0;
+    }
+    d->mLoopbackPeer = peer;
+    if ( peer != 0 ) {
+        if ( peer->d->mLoopbackPeer ) {
+            peer->d->mLoopbackPeer->d->mLoopbackPeer = 0;
+        }
+        peer->d->mLoopbackPeer = this;
+    }
+}
+
+/**
+ * @sa setLoopbackPeer(ServicesManager *)
+ */
+ServicesManager *ServicesManager::loopbackPeer() const
+{
+    return d->mLoopbackPeer;
+}
+
+/**
+ * If enabled messages sent to the loopback peer are serialized with
+ * serializer() and passed to the receive(const QByteArray &) slot of the
+ * peer. Slower but lets tests catch values the serializer can't transfer.
+ * Disabled by default.
+ *
+ * @sa setLoopbackPeer(ServicesManager *)
+ */
+void ServicesManager::setLoopbackSerialization(bool enabled)
+{
+    d->mLoopbackSerialization = enabled;
+}
+
+/**
+ * @sa setLoopbackSerialization(bool)
+ */
+bool ServicesManager::loopbackSerialization() const
+{
+    return d->mLoopbackSerialization;
+}
+
+/**
+ * @internal
+ *
+ * Delivers message to the loopback peer. Copy of the message only shares
+ * its strings and params with the original one and is handed over to the
+ * peer which may move it to the service thread.
+ */
+void ServicesManager::loopback(const Message &msg)
+{
+    ServicesManager *peer = d->mLoopbackPeer;
+    if ( d->mLoopbackSerialization ) {
+        if ( d->mSerializer ) {
+            peer->receive(d->mSerializer->serialize(msg));
+        }
+        return;
+    }
+    peer->dispatch(0, 0, MessageAP(new Message(msg)));
+    peer->flushBatches();
+}
+
+/**
+ * Sets recorder used to capture raw messages received and sent by this
+ * manager. Messages received from devices added with addDevice(QIODevice*)
+ * method are recorded with the device id (see deviceId(QIODevice *)) and
+ * messages passing through receive(const QByteArray &) slot and
+ * send(QByteArray) signal with id 0. Recorded traffic can be replayed with
+ * TrafficReplay.
+ *
+ * Recorder is not owned by the manager. Pass 0 to stop recording.
+ */
+void ServicesManager::setRecorder(TrafficRecorder *recorder)
+{
+    d->mRecorder = recorder;
+}
+
+TrafficRecorder *ServicesManager::recorder() const
+{
+    return d->mRecorder;
+}
+
+/**
+ * @return id of the device added with addDevice(QIODevice*) method or 0 if
+ * there is no such device. Ids are unique within the manager and never
+ * reused.
+ */
+quint32 ServicesManager::deviceId(QIODevice *dev) const
+{
+    internals::Connection *conn = d->mDevicesIndex.value(dev, 0);
+    return conn != 0 ? conn->mId : 0;
+}
+
+/**
+ * @return true if peers of the new devices are offered to negotiate wire
+ * format.
+ * @sa setProtocolNegotiation(bool)
+ */
+bool ServicesManager::protocolNegotiation() const
+{
+    return d->mProtocolNegotiation;
+}
+
+/**
+ * Limits number of messages each device added with the addDevice(QIODevice *)
+ * method can receive per second. Each device has its own token bucket which
+ * is refilled with @a rate tokens per second up to @a burst tokens. Message
+ * received takes one token and the @a action is applied if the bucket is
+ * empty. Control frames (keep-alive pings, negotiation) are not limited.
+ *
+ * Limit is checked before the message is deserialized so dropped messages
+ * cost almost nothing.
+ *
+ * @note DelayReading action only stops reading from the device. Set read
+ * buffer size of the socket (QAbstractSocket::setReadBufferSize) to make the
+ * peer feel the backpressure.
+ *
+ * @param rate messages per second. 0 disables the limit.
+ * @param burst number of messages allowed at once after the idle period.
+ * @param action what to do with the message exceeding the limit.
+ *
+ * @sa rateLimitExceeded(QIODevice *)
+ */
+void ServicesManager::setRateLimit(double rate, int burst, RateLimitAction action)
+{
+    d->mRate = rate;
+    d->mBurst = burst;
+    d->mRateLimitAction = action;
+    foreach (const QSharedPointer<internals::Connection> &conn, d->mConnections) {
+        conn->mDevManager->setRateLimit(rate, burst, action == DelayReading);
+    }
+}
+
+/**
+ * Limits number of calls of the method of the service each device added with
+ * the addDevice(QIODevice *) method can make per second. If @a method is
+ * empty the limit is applied to all the methods of the service together.
+ * Both method and service limits are checked for each call.
+ *
+ * These limits are checked after the message is deserialized.
+ *
+ * @sa setRateLimit(double, int, RateLimitAction)
+ */
+void ServicesManager::setRateLimit(const QString &service, const QString &method,
+                                   double rate, int burst, RateLimitAction action)
+{
+    if ( rate > 0 ) {
+        internals::RateLimit limit;
+        limit.rate = rate;
+        limit.burst = burst;
+        limit.action = action;
+        d->mRateLimits[service].insert(method, limit);
+    } else {
+        internals::RateLimits::iterator limits = d->mRateLimits.find(service);
+        if ( limits != d->mRateLimits.end() ) {
+            limits->remove(method);
+            // Dispatch skips the limits entirely while there are none
+            if ( limits->isEmpty() ) {
+                d->mRateLimits.erase(limits);
+            }
+        }
+    }
+    // Buckets are created with the new limit on the next call
+    foreach (const QSharedPointer<internals::Connection> &conn, d->mConnections) {
+        QHash< QString, QHash<QString, internals::TokenBucket> >::iterator buckets =
+            conn->mBuckets.find(service);
+        if ( buckets != conn->mBuckets.end() ) {
+            buckets->remove(method);
+        }
+    }
+}
+
+/**
+ * If enabled, every device added with addDevice(QIODevice*) method after
+ * this call starts with a control frame offering the peer to switch to one
+ * of the supportedSerializers(). Peer selects the first serializer from its
+ * own list of supported serializers which is present in the offer. From that
+ * point each side reads and writes messages of this device with the selected
+ * serializer while other devices of the same manager keep using their own
+ * serializers. Messages sent before the peer has replied are written with
+ * serializer() and it's safe to send them immediately after the device is
+ * added.
+ *
+ * Every manager answers such offers regardless of this setting so it's
+ * enough to enable negotiation on the side initiating connections. If both
+ * peers enable it only the one whose offer compares greater byte by byte
+ * answers and the other one accepts its selection. Servers
+ * can keep serializer() compatible with old clients (for example
+ * jsonSerializer) while new clients switch to more efficient format.
+ *
+ * @note QRemoteSignal versions before 1.4.0 can't answer the offer and
+ * will fail to read it. Don't enable negotiation for devices connected to
+ * such peers.
+ *
+ * Negotiation is disabled by default.
+ *
+ * @sa setSupportedSerializers
+ * @sa protocolNegotiated(QIODevice *, qrs::AbsMessageSerializer *)
+ */
+void ServicesManager::setProtocolNegotiation(bool enabled)
+{
+    d->mProtocolNegotiation = enabled;
+}
+
+/**
+ * @sa setSupportedSerializers
+ */
+QList<AbsMessageSerializer*> ServicesManager::supportedSerializers() const
+{
+    return d->mSupportedSerializers;
+}
+
+/**
+ * Sets list of serializers which can be selected during the wire format
+ * negotiation ordered by preference. Serializers having empty
+ * AbsMessageSerializer::protocolId() are ignored. This function doesn't
+ * take ownership on the serializers and they should not be deleted while
+ * this manager exists.
+ *
+ * By default the list contains global instances of QDataStreamSerializer
+ * from qDataStreamSerializer_4_5 down to qDataStreamSerializer_4_0 followed
+ * by jsonSerializer.
+ *
+ * @note New list affects only negotiations which are not yet started.
+ *
+ * @sa setProtocolNegotiation(bool)
+ */
+void ServicesManager::setSupportedSerializers(const QList<AbsMessageSerializer*> &val)
+{
+    d->mSupportedSerializers.clear();
+    foreach (AbsMessageSerializer *serializer, val) {
+        if ( serializer != 0 ) {
+            d->mSupportedSerializers.append(serializer);
+        }
+    }
+}
+
+/**
+ * @return serializer used to write messages to the device added with
+ * addDevice(QIODevice *) method or 0 if there is no such device.
+ */
+AbsMessageSerializer *ServicesManager::deviceSerializer(QIODevice *dev)
+{
+    internals::Connection *conn = d->mDevicesIndex.value(dev, 0);
+    if ( conn == 0 ) {
+        return 0;
+    }
+    if ( conn->mOutSerializer != 0 ) {
+        return conn->mOutSerializer;
+    }
+    return d->mSerializer;
+}
+
+/**
+ * Adds device to the named group of subscribers. Group is created
+ * automatically when the first device joins it and removed when the last
+ * one leaves it. Device is removed from all groups when it's removed from
+ * this manager or deleted.
+ *
+ * This function does nothing if device was not added to this manager with
+ * addDevice(QIODevice *) method.
+ *
+ * @note Group membership changes take constant time regardless of the
+ * number of the group members.
+ *
+ * @sa publish(const QString &, const Message &)
+ * @sa setSignalGroup(const QString &, const QString &, const QString &)
+ */
+void ServicesManager::joinGroup(const QString &group, QIODevice *dev)
+{
+    internals::Connection *conn = d->mDevicesIndex.value(dev, 0);
+    if ( conn == 0 ) {
+        return;
+    }
+    conn->mGroups.insert(group);
+    d->mGroups[group].insert(conn);
+}
+
+void ServicesManager::leaveGroup(const QString &group, QIODevice *dev)
+{
+    internals::Connection *conn = d->mDevicesIndex.value(dev, 0);
+    if ( conn == 0 || !conn->mGroups.remove(group) ) {
+        return;
+    }
+    QHash< QString, QSet<internals::Connection*> >::iterator it = d->mGroups.find(group);
+    it.value().remove(conn);
+    if ( it.value().isEmpty() ) {
+        d->mGroups.erase(it);
+    }
+}
+
+bool ServicesManager::isGroupMember(const QString &group, QIODevice *dev) const
+{
+    internals::Connection *conn = d->mDevicesIndex.value(dev, 0);
+    return conn != 0 && conn->mGroups.contains(group);
+}
+
+/**
+ * @return number of devices in the group.
+ */
+int ServicesManager::groupSize(const QString &group) const
+{
+    return d->mGroups.value(group).size();
+}
+
+/**
+ * Makes all emissions of the @a signal of the @a service registered in this
+ * manager to be sent only to the members of the @a group instead of all
+ * devices. Empty @a group name restores default behaviour.
+ *
+ * @note Such messages are not passed to the send(QByteArray) signal.
+ *
+ * @sa publish(const QString &, const Message &)
+ */
+void ServicesManager::setSignalGroup(const QString &service,
+                                     const QString &signal,
+                                     const QString &group)
+{
+    if ( group.isEmpty() ) {
+        d->mSignalGroups.remove(service + "::" + signal);
+    } else {
+        d->mSignalGroups.insert(service + "::" + signal, group);
+    }
+}
+
+/**
+ * @return name of the group signal of the service is sent to or empty string
+ * if it's sent to all devices.
+ */
+QString ServicesManager::signalGroup(const QString &service,
+                                     const QString &signal) const
+{
+    return d->mSignalGroups.value(service + "::" + signal);
+}
+
+/**
+ * @internal
+ *
+ * Sends message to all members of the group. Message is serialized once per
+ * distinct serializer used by the members and the same raw message is
+ * shared between all of them. Does nothing if there is no such group.
+ *
+ * This function provided to be used by the send(const Message &) function
+ * and the classes generated from service interface description.
+ */
+void ServicesManager::publish(const QString &group, const Message &msg)
+{
+    if ( !d->mSerializer ) return;
+    QHash< QString, QSet<internals::Connection*> >::const_iterator it =
+        d->mGroups.constFind(group);
+    if ( it == d->mGroups.constEnd() ) {
+        return;
+    }
+    QHash<AbsMessageSerializer*, QByteArray> cache;
+    foreach (internals::Connection *conn, it.value()) {
+        if ( conn->accepts(msg) ) {
+            d->transmit( conn, d->encode(conn, msg, cache) );
+        }
+    }
+    d->recycle(cache);
+}
+
+/**
+ * @internal
+ *
+ * Asks peers of all devices to send emissions of the @a signal of the
+ * @a service only if all parameters named in the @a filter are equal to the
+ * values given. Empty filter subscribes to every emission. Several
+ * subscriptions to the same signal are combined with logical "or".
+ *
+ * Once the peer got the first subscription for the service it stops sending
+ * signals of this service which are not subscribed. Peers which never got
+ * subscription requests for the service send all of its signals.
+ *
+ * Filter values are compared with QVariant::operator==() after
+ * deserialization so it's reliable only for the parameters of the numeric,
+ * boolean and string types. Subscribing with the same filter again changes
+ * nothing. Peer rejects more than 32 distinct filters per signal.
+ *
+ * Only peers of the devices added with addDevice(QIODevice *) track
+ * subscriptions. Manager getting the request through
+ * receive(const QByteArray &) or the loopback link replies with
+ * Message::IncorrectMethod error.
+ *
+ * This function provided to be used by client classes generated from
+ * service interface description.
+ *
+ * @note QRemoteSignal versions before 1.4.0 reply with error message on
+ * subscription request.
+ *
+ * @sa unsubscribe(const QString &, const QString &)
+ */
+void ServicesManager::subscribe(const QString &service, const QString &signal,
+                                const QVariantMap &filter)
+{
+    Message msg;
+    msg.setService(service);
+    msg.setMethod(internals::SUBSCRIBE);
+    msg.params().insert("signal", qrs::createArg(signal));
+    if ( !filter.isEmpty() ) {
+        msg.params().insert("filter", filter);
+    }
+    send(msg);
+}
+
+/**
+ * @internal
+ *
+ * Cancels all subscriptions to the @a signal of the @a service. Peer keeps
+ * filtering other signals of the service.
+ *
+ * @sa subscribe(const QString &, const QString &, const QVariantMap &)
+ */
+void ServicesManager::unsubscribe(const QString &service, const QString &signal)
+{
+    Message msg;
+    msg.setService(service);
+    msg.setMethod(internals::UNSUBSCRIBE);
+    msg.params().insert("signal", qrs::createArg(signal));
+    send(msg);
+}
+
+/**
+ * @internal
+ *
+ * This slot processes messages received from the devices added by the
+ * addDevice method with serializer negotiated for the device.
+ */
+void ServicesManager::onDeviceReceived(const QByteArray &msg)
+{
+    internals::DeviceManager *source = qobject_cast<internals::DeviceManager*>(sender());
+    // Shared device manager delivers messages of all channels to everybody
+    internals::Connection *conn = d->mConnectionsIndex.value(source, 0);
+    if ( conn != 0 && conn->mChannel != source->receiveChannel() ) {
+        return;
+    }
+    process(source, msg);
+}
+
+/**
+ * @internal
+ *
+ * This slot handles wire format negotiation.
+ */
+void ServicesManager::onControlFrame(internals::DeviceManager *source,
+                                     quint32 frame, const QByteArray &payload)
+{
+    internals::Connection *conn = d->mConnectionsIndex.value(source, 0);
+    if ( conn == 0 || frame != internals::DeviceManager::HelloFrame ||
+         conn->mChannel != source->receiveChannel() ) {
+        return;
+    }
+    if ( payload.startsWith(internals::OFFER) ) {
+        // If both peers offered only the one with the greater offer answers
+        // so they don't select different formats. Equal offers lead to the
+        // same selection on both sides.
+        if ( !conn->mOffer.isEmpty() && conn->mOffer < payload ) {
+            return;
+        }
+        QList<QByteArray> offer = payload.mid(qstrlen(internals::OFFER)).split(',');
+        AbsMessageSerializer *selected = 0;
+        foreach (AbsMessageSerializer *serializer, d->mSupportedSerializers) {
+            if ( offer.contains(serializer->protocolId()) ) {
+                selected = serializer;
+                break;
+            }
+        }
+        if ( selected == 0 ) {
+            // Peer keeps using the default serializer
+            source->sendControlFrame(internals::DeviceManager::HelloFrame,
+                                     internals::SELECT, conn->mChannel);
+            return;
+        }
+        // Everything written after the reply uses selected serializer.
+        // Incoming messages are switched when peer sends SWITCH.
+        source->sendControlFrame(internals::DeviceManager::HelloFrame,
+                                 internals::SELECT + selected->protocolId(),
+                                 conn->mChannel);
+        conn->mOutSerializer = selected;
+        emit protocolNegotiated(source->device(), selected);
+    } else if ( payload.startsWith(internals::SELECT) ) {
+        AbsMessageSerializer *selected =
+            d->supported(payload.mid(qstrlen(internals::SELECT)));
+        if ( selected == 0 ) {
+            return;
+        }
+        conn->mInSerializer = selected;
+        conn->mOutSerializer = selected;
+        source->sendControlFrame(internals::DeviceManager::HelloFrame,
+                                 internals::SWITCH, conn->mChannel);
+        emit protocolNegotiated(source->device(), selected);
+    } else if ( payload == internals::SWITCH ) {
+        conn->mInSerializer = conn->mOutSerializer;
     }
 }
 
@@ -399,14 +1683,13 @@ void ServicesManager::setMessageSizeLimit(quint32 val)
  */
 void ServicesManager::onDeviceDeleted(QObject* dev)
 {
-    QList< QSharedPointer<internals::DeviceManager> >::iterator it;
-    for ( it = d->mDevManagers.begin(); it != d->mDevManagers.end(); it++ ) {
-        QObject *currentDev = (*it)->device();
+    for ( int i = 0; i < d->mConnections.size(); i++ ) {
+        QObject *currentDev = d->mConnections[i]->mDevManager->device();
         // DeviceManager stores QPointer instead of normal pointers and it can
         // know that dev is deleted before this slot is called. That's why I
         // should check that currentDev is non-zero.
         if ( !currentDev || currentDev == dev ) {
-            d->mDevManagers.erase(it);
+            d->takeConnection(i);
             return;
         }
     }
@@ -420,12 +1703,107 @@ void ServicesManager::onDeviceDeleted(QObject* dev)
  */
 void ServicesManager::onMessageTooBig(internals::DeviceManager *source)
 {
-    Message err;
-    err.setType(Message::Error);
-    err.setErrorType(Message::ProtocolError);
-    err.setError(QString("Message bigger then allowed limit '%1' bytes").arg(source->maxMessageSize()));
-    emit send( d->mSerializer->serialize(err) );
-    emit clientError(this, err.errorType(), err.error());
+    sendError(source, Status(Message::ProtocolError,
+                             "Message bigger then allowed limit '%1' bytes",
+                             source->maxMessageSize()));
     source->device()->close();
     emit messageTooBig(source->device());
 }
+
+/**
+ * @internal
+ *
+ * Closes the device which received frame rejected by its transport. No error
+ * reply is sent since the peer may be an attacker.
+ */
+void ServicesManager::onTransportError(internals::DeviceManager *source)
+{
+    QIODevice *dev = source->device();
+    if ( dev == 0 ) {
+        return;
+    }
+    dev->close();
+    emit transportError(dev);
+}
+
+/**
+ * @internal
+ *
+ * Delivers batch signals of all registered services. Services which have
+ * nothing collected return immediately.
+ */
+void ServicesManager::flushBatches()
+{
+    foreach (AbsService *service, d->mServices) {
+        service->flushBatches();
+    }
+}
+
+/**
+ * @internal
+ *
+ * Sends error reported by the service living in other thread. @a source is
+ * used as a key only since the device manager can be already deleted.
+ */
+void ServicesManager::onDispatchError(QObject *source, int code,
+                                      const QString &detail,
+                                      const QString &service,
+                                      const QString &method)
+{
+    internals::DeviceManager *dm = static_cast<internals::DeviceManager*>(source);
+    if ( dm != 0 && !d->mConnectionsIndex.contains(dm) ) {
+        return;
+    }
+    sendError(dm, Status(Message::ErrorType(code), detail), service, method);
+}
+
+/**
+ * @internal
+ *
+ * This slot delivers calls received from the device at once with the batch
+ * signals of the services.
+ */
+void ServicesManager::onReadPassFinished(internals::DeviceManager *)
+{
+    flushBatches();
+}
+
+/**
+ * @internal
+ *
+ * This slot applies CloseDevice action of the device rate limit. Messages
+ * are already dropped or reading paused by the device manager.
+ */
+void ServicesManager::onRateLimitExceeded(internals::DeviceManager *source)
+{
+    QIODevice *dev = source->device();
+    if ( d->mRateLimitAction == CloseDevice && dev != 0 ) {
+        dev->close();
+    }
+    emit rateLimitExceeded(dev);
+}
+
+/**
+ * @internal
+ *
+ * This slot removes device which peer doesn't respond from the list of
+ * devices, closes it and sends notification.
+ */
+void ServicesManager::onPeerTimeout(internals::DeviceManager *source)
+{
+    for ( int i = 0; i < d->mConnections.size(); i++ ) {
+        // Device manager could be already removed while the queued signal
+        // was waiting for delivery. Pointer is only compared here.
+        if ( d->mConnections[i]->mDevManager.data() != source ) {
+            continue;
+        }
+        QIODevice *dev = d->takeConnection(i)->mDevManager->device();
+        if ( dev != 0 ) {
+            disconnect( dev, SIGNAL(destroyed( QObject* )),
+                        this, SLOT(onDeviceDeleted(QObject*)) );
+            dev->close();
+            emit peerTimeout(dev);
+        }
+        return;
+    }
+}
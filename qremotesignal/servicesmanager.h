@@ -11,9 +11,15 @@
 #include <QtCore/QObject>
 #include <QtCore/QString>
 #include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVariantMap>
 
 #include "qrsexport.h"
 #include "message.h"
+#include "status.h"
+#include "datagramstats.h"
+#include "bufferpoolstats.h"
 
 // Forward declarations
 class QIODevice;
@@ -24,9 +30,12 @@ namespace qrs {
    namespace internals {
       class ServicesManagerPrivate;
       class DeviceManager;
+      class Connection;
    };
    class AbsMessageSerializer;
    class AbsService;
+   class TrafficRecorder;
+   class AbsTransport;
 
    /**
     * @brief Class managing communications between services and clients.
@@ -53,17 +62,51 @@ namespace qrs {
     * There are two ways how to send and receive messages:
     * @li Using addDevice function to set device to be used to send/receive
     * messages. This class designed to work with sequential QIODevices (for
-    * example QTcpSocket, QUdpSocket, QProcess).
+    * example QTcpSocket, QUdpSocket, QProcess). Connected QUdpSocket gets
+    * one message per datagram without length prefix (see
+    * setDatagramSize(int)).
     * @li Using receive slot to pass received message to the ServicesManager
     * and listening send signal to obtain raw messages to be sent. In this case
     * you need to write your own mechanism to send/receive raw messages.
     *
+    * By default every outgoing message is sent to all devices. Devices can be
+    * added to named groups of subscribers with joinGroup(const QString &,
+    * QIODevice *) and signals of the services can be routed to the group
+    * members only with setSignalGroup(const QString &, const QString &,
+    * const QString &):
+    * @code
+    * manager->setSignalGroup("Quotes", "priceChanged", "quotes");
+    * manager->joinGroup("quotes", socket);
+    * @endcode
+    *
+    * Several managers, for example using different serializers, can share
+    * one device using different logical channels (see addChannel(QIODevice *,
+    * int)).
+    *
+    * Two managers of the same thread can be linked with
+    * setLoopbackPeer(ServicesManager *) to exchange messages without
+    * serialization and devices.
+    *
     * @sa @ref generated_classes
     */
    class QRS_EXPORT ServicesManager : public QObject {
       Q_OBJECT
       Q_DISABLE_COPY(ServicesManager);
       public:
+         /// @brief What to do with messages exceeding the rate limit
+         enum RateLimitAction {
+            /// Message is discarded without error reply
+            DropMessages,
+            /**
+             * Message is processed but reading from the device is paused
+             * until the limit allows next message. Unread data stays in the
+             * device buffer.
+             */
+            DelayReading,
+            /// Message is discarded and device is closed
+            CloseDevice
+         };
+
          explicit ServicesManager(QObject *parent = 0);
          virtual ~ServicesManager();
 
@@ -78,6 +121,8 @@ namespace qrs {
          AbsService *service(const QString &name);
 
          void send(const Message& msg);
+         /// @brief Check if anybody can get a message sent
+         bool hasConsumers() const;
 
          void setSerializer(AbsMessageSerializer* val);
          /**
@@ -90,6 +135,10 @@ namespace qrs {
 
          /// @brief Add IO device to send receive data
          void addDevice(QIODevice* dev);
+         /// @brief Add IO device protecting messages with the transport
+         void addDevice(QIODevice* dev, AbsTransport *transport);
+         /// @brief Add logical channel of the device shared by several managers
+         bool addChannel(QIODevice* dev, int channel);
          /// @brief Returns number of the devices used to send/receive messages
          int devicesCount() const;
          /// @brief Returns device used for cimunication by the index
@@ -105,8 +154,89 @@ namespace qrs {
          quint32 messageSizeLimit() const;
          /// @brief %Message size limit for devices added with addDevice method
          void setMessageSizeLimit(quint32 val);
+
+         /// @brief Keep-alive settings for devices added with addDevice method
+         void setKeepAlive(int interval, int timeout);
+         /// @brief Idle interval in milliseconds before ping is sent
+         int keepAliveInterval() const;
+         /// @brief Silence interval in milliseconds before peer is dead
+         int keepAliveTimeout() const;
+
+         /// @brief Read budget for devices added with addDevice method
+         void setReadBudget(int frames, int bytes = 0);
+         /// @brief Maximum number of messages read from a device at once
+         int readBudgetFrames() const;
+         /// @brief Maximum number of bytes read from a device at once
+         int readBudgetBytes() const;
+
+         /// @brief Maximum datagram size for QUdpSocket devices
+         void setDatagramSize(int size);
+         /// @brief Maximum datagram size for QUdpSocket devices
+         int datagramSize() const;
+         /// @brief Datagram counters of the QUdpSocket device
+         DatagramStats datagramStats(QIODevice *dev) const;
+
+         /// @brief Message buffer pool counters of the calling thread
+         static BufferPoolStats bufferPoolStats();
+
+         void setRateLimit(double rate, int burst,
+                           RateLimitAction action = DropMessages);
+         void setRateLimit(const QString &service, const QString &method,
+                           double rate, int burst,
+                           RateLimitAction action = DropMessages);
+
+         /// @brief Process messages in the threads of the services
+         void setThreadDispatch(bool enabled);
+         /// @brief Process messages in the threads of the services
+         bool threadDispatch() const;
+
+         /// @brief Deliver sent messages directly to the manager in the same thread
+         void setLoopbackPeer(ServicesManager *peer);
+         /// @brief Manager linked with setLoopbackPeer or 0
+         ServicesManager *loopbackPeer() const;
+         /// @brief Serialize messages delivered to the loopback peer
+         void setLoopbackSerialization(bool enabled);
+         /// @brief Serialize messages delivered to the loopback peer
+         bool loopbackSerialization() const;
+
+         /// @brief Record all received and sent raw messages
+         void setRecorder(TrafficRecorder *recorder);
+         /// @brief Recorder set with setRecorder or 0
+         TrafficRecorder *recorder() const;
+         /// @brief Id of the device used in the traffic record
+         quint32 deviceId(QIODevice *dev) const;
+
+         /// @brief Offer wire format negotiation to peers of new devices
+         void setProtocolNegotiation(bool enabled);
+         /// @brief Offer wire format negotiation to peers of new devices
+         bool protocolNegotiation() const;
+         /// @brief Serializers which can be selected during negotiation
+         void setSupportedSerializers(const QList<AbsMessageSerializer*> &val);
+         /// @brief Serializers which can be selected during negotiation
+         QList<AbsMessageSerializer*> supportedSerializers() const;
+         /// @brief Serializer used to send messages to the device
+         AbsMessageSerializer *deviceSerializer(QIODevice *dev);
+
+         /// @brief Add device to the named group of subscribers
+         void joinGroup(const QString &group, QIODevice *dev);
+         /// @brief Remove device from the named group of subscribers
+         void leaveGroup(const QString &group, QIODevice *dev);
+         /// @brief Check if device is member of the group
+         bool isGroupMember(const QString &group, QIODevice *dev) const;
+         /// @brief Number of devices in the group
+         int groupSize(const QString &group) const;
+         /// @brief Send service signal to the group members only
+         void setSignalGroup(const QString &service, const QString &signal,
+                             const QString &group);
+         /// @brief Group the service signal is sent to
+         QString signalGroup(const QString &service,
+                             const QString &signal) const;
+         void publish(const QString &group, const Message &msg);
+         void subscribe(const QString &service, const QString &signal,
+                        const QVariantMap &filter = QVariantMap());
+         void unsubscribe(const QString &service, const QString &signal);
       public slots:
-         void receive(const QByteArray& msg);
+         Status receive(const QByteArray& msg);
       signals:
          /**
           * This signal is emited when a message should be sent.
@@ -137,15 +267,91 @@ namespace qrs {
           * @param device device which received message causing this error.
           */
          void messageTooBig(QIODevice *device);
+         /**
+          * This signal is emitted if nothing was received from one of the
+          * devices added with the addDevice(QIODevice *) method during the
+          * keep-alive timeout. At the moment this signal is emitted the
+          * device is already closed and removed from the list of devices
+          * used by this manager.
+          *
+          * One of the possible reactions on this segnal is to call
+          * deleterLater() method of the device.
+          *
+          * @param device device which peer stopped responding.
+          *
+          * @sa setKeepAlive(int, int)
+          */
+         void peerTimeout(QIODevice *device);
+         /**
+          * This signal is emitted when the peer of the device added with
+          * the addDevice(QIODevice *) method agreed to use serializer
+          * other then serializer() for this device.
+          *
+          * @param device device which wire format is changed.
+          * @param serializer serializer used for the device from now.
+          *
+          * @sa setProtocolNegotiation(bool)
+          */
+         void protocolNegotiated(QIODevice *device,
+                                 qrs::AbsMessageSerializer *serializer);
+         /**
+          * This signal is emitted when message received from the device
+          * added with the addDevice(QIODevice *) method exceeds one of the
+          * rate limits. The action of the limit is already applied at this
+          * moment.
+          *
+          * @param device device which peer sends messages too fast.
+          *
+          * @sa setRateLimit(double, int, RateLimitAction)
+          */
+         void rateLimitExceeded(QIODevice *device);
+         /**
+          * This signal is emitted when the transport of the stream device
+          * added with the addDevice(QIODevice *, AbsTransport *) method
+          * rejects the frame received or fails to protect the message sent.
+          * At the moment this signal is emitted the device is already
+          * closed.
+          *
+          * @param device device which received damaged or forged frame.
+          */
+         void transportError(QIODevice *device);
       private:
          internals::ServicesManagerPrivate *const d;
 
          static AbsMessageSerializer *mDefaultSerializer;
+
+         Status process(internals::DeviceManager *source, const QByteArray &msg);
+         Status dispatch(internals::DeviceManager *source,
+                         internals::Connection *conn, MessageAP message);
+         void sendError(internals::DeviceManager *source, const Status &status,
+                        const QString &service = QString(),
+                        const QString &method = QString());
+         bool admit(internals::Connection *conn, const Message &msg);
+         void loopback(const Message &msg);
+         void attach(const QSharedPointer<internals::Connection> &conn,
+                     AbsTransport *transport, bool configure);
+         void flushBatches();
       private slots:
          /// @brief Called if device added by addDevice method is deleted
          void onDeviceDeleted(QObject* dev);
          /// @brief Called if device added by the addDevice method received too big message
          void onMessageTooBig(qrs::internals::DeviceManager *source);
+         /// @brief Called if peer of the device added by the addDevice method is dead
+         void onPeerTimeout(qrs::internals::DeviceManager *source);
+         /// @brief Called if device added by the addDevice method received message
+         void onDeviceReceived(const QByteArray &msg);
+         /// @brief Called if device added by the addDevice method received control frame
+         void onControlFrame(qrs::internals::DeviceManager *source,
+                             quint32 frame, const QByteArray &payload);
+         /// @brief Called if device added by the addDevice method exceeded rate limit
+         void onRateLimitExceeded(qrs::internals::DeviceManager *source);
+         /// @brief Called when messages received by the device at once are processed
+         void onReadPassFinished(qrs::internals::DeviceManager *source);
+         /// @brief Called if transport of the device added by the addDevice method rejected frame
+         void onTransportError(qrs::internals::DeviceManager *source);
+         /// @brief Called if service living in other thread failed to process message
+         void onDispatchError(QObject *source, int code, const QString &detail,
+                              const QString &service, const QString &method);
    };
 
 }
@@ -0,0 +1,257 @@
+/**
+ * @file servicesserver.cpp
+ * @brief ServicesServer implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "servicesserver.h"
+
+#include <QtCore/QList>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+#include "servicesmanager.h"
+#include "connectionattacher.h"
+
+namespace qrs {
+namespace internals {
+
+#if QT_VERSION >= 0x050000
+typedef qintptr SocketDescriptor;
+#else
+typedef int SocketDescriptor;
+#endif
+
+/**
+ * @internal
+ *
+ * QTcpServer passing socket descriptors to the ServicesServer instead of
+ * creating QTcpSocket instances in the listener thread.
+ */
+class TcpListener: public QTcpServer {
+public:
+    explicit TcpListener(ServicesServerPrivate *server): mServer(server) {}
+protected:
+    virtual void incomingConnection(SocketDescriptor socketDescriptor);
+private:
+    ServicesServerPrivate *mServer;
+};
+
+class ServicesServerPrivate {
+public:
+    ServicesServerPrivate(ServicesServer *q): q(q), mListener(this) {}
+
+    void onIncomingConnection(SocketDescriptor socketDescriptor);
+
+    ServicesServer *const q;
+    TcpListener mListener;
+    QTimer mRateTimer;
+    QList<ConnectionAttacher*> mAttachers;
+    int mMaxConnections;
+    quint64 mAccepted;
+    quint64 mRejected;
+    int mAcceptedThisSecond;
+    int mAcceptRate;
+};
+
+void TcpListener::incomingConnection(SocketDescriptor socketDescriptor)
+{
+    mServer->onIncomingConnection(socketDescriptor);
+}
+
+void ServicesServerPrivate::onIncomingConnection(SocketDescriptor socketDescriptor)
+{
+    if (mMaxConnections > 0 && q->connectionsCount() >= mMaxConnections) {
+        QTcpSocket socket;
+        socket.setSocketDescriptor(socketDescriptor);
+        socket.abort();
+        mRejected++;
+        emit q->connectionRejected();
+        return;
+    }
+    ConnectionAttacher *target = 0;
+    foreach (ConnectionAttacher *attacher, mAttachers) {
+        if (attacher->manager() == 0) {
+            continue;
+        }
+        if (target == 0 ||
+            attacher->connectionsCount() < target->connectionsCount()) {
+            target = attacher;
+        }
+    }
+    if (target == 0) {
+        QTcpSocket socket;
+        socket.setSocketDescriptor(socketDescriptor);
+        socket.abort();
+        return;
+    }
+    mAccepted++;
+    mAcceptedThisSecond++;
+    target->reserve();
+    if (target->thread() == QThread::currentThread()) {
+        target->attach(int(socketDescriptor));
+    } else {
+        QMetaObject::invokeMethod(target, "attach", Qt::QueuedConnection,
+                                  Q_ARG(int, int(socketDescriptor)));
+    }
+}
+
+}
+}
+
+using namespace qrs;
+
+/**
+ * Creates server attaching connections to the manager given. Server doesn't
+ * start listening until listen() is called.
+ */
+ServicesServer::ServicesServer(ServicesManager *manager, QObject *parent):
+        QObject(parent),
+        d(new internals::ServicesServerPrivate(this))
+{
+    d->mMaxConnections = 0;
+    d->mAccepted = 0;
+    d->mRejected = 0;
+    d->mAcceptedThisSecond = 0;
+    d->mAcceptRate = 0;
+    d->mRateTimer.setInterval(1000);
+    connect(&d->mRateTimer, SIGNAL(timeout()),
+            this, SLOT(onRateTimer()));
+    addManager(manager);
+}
+
+/**
+ * Stops listening. Connections attached to the managers living in other
+ * threads are closed and deleted in their threads.
+ */
+ServicesServer::~ServicesServer()
+{
+    d->mListener.close();
+    foreach (internals::ConnectionAttacher *attacher, d->mAttachers) {
+        attacher->deleteLater();
+    }
+    delete d;
+}
+
+/**
+ * Adds one more manager to shard new connections across. Manager can live in
+ * any thread but it should not be moved to another thread after it's added
+ * to the server.
+ */
+void ServicesServer::addManager(ServicesManager *manager)
+{
+    d->mAttachers.append(new internals::ConnectionAttacher(manager));
+}
+
+int ServicesServer::managersCount() const
+{
+    return d->mAttachers.count();
+}
+
+/**
+ * @return true on success. In case of failure use errorString() to get
+ * error description.
+ */
+bool ServicesServer::listen(const QHostAddress &address, quint16 port)
+{
+    if (!d->mListener.listen(address, port)) {
+        return false;
+    }
+    d->mAcceptedThisSecond = 0;
+    d->mRateTimer.start();
+    return true;
+}
+
+void ServicesServer::close()
+{
+    d->mListener.close();
+    d->mRateTimer.stop();
+    d->mAcceptRate = 0;
+}
+
+bool ServicesServer::isListening() const
+{
+    return d->mListener.isListening();
+}
+
+quint16 ServicesServer::serverPort() const
+{
+    return d->mListener.serverPort();
+}
+
+QHostAddress ServicesServer::serverAddress() const
+{
+    return d->mListener.serverAddress();
+}
+
+QString ServicesServer::errorString() const
+{
+    return d->mListener.errorString();
+}
+
+/**
+ * @return maximum number of simultaneous connections or 0 if number of
+ * connections is not limited.
+ */
+int ServicesServer::maxConnections() const
+{
+    return d->mMaxConnections;
+}
+
+/**
+ * If number of live connections reaches this limit new connections are
+ * closed immediately after they are accepted and connectionRejected() signal
+ * is emitted. Established connections are never closed by this limit.
+ *
+ * Default value 0 means no limit.
+ */
+void ServicesServer::setMaxConnections(int val)
+{
+    d->mMaxConnections = qMax(val, 0);
+}
+
+/**
+ * @return number of connections which are accepted and not yet closed in
+ * all managers.
+ */
+int ServicesServer::connectionsCount() const
+{
+    int res = 0;
+    foreach (internals::ConnectionAttacher *attacher, d->mAttachers) {
+        res += attacher->connectionsCount();
+    }
+    return res;
+}
+
+quint64 ServicesServer::acceptedCount() const
+{
+    return d->mAccepted;
+}
+
+quint64 ServicesServer::rejectedCount() const
+{
+    return d->mRejected;
+}
+
+/**
+ * @return number of connections accepted during the last full second. Value
+ * is updated once per second while server is listening.
+ */
+int ServicesServer::acceptRate() const
+{
+    return d->mAcceptRate;
+}
+
+/**
+ * @internal
+ *
+ * Updates accept rate statistics once per second.
+ */
+void ServicesServer::onRateTimer()
+{
+    d->mAcceptRate = d->mAcceptedThisSecond;
+    d->mAcceptedThisSecond = 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file servicesserver.h
+ * @brief ServicesServer class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _ServicesServer_H
+#define _ServicesServer_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtNetwork/QHostAddress>
+
+#include "qrsexport.h"
+
+namespace qrs {
+
+   // Forward declarations
+   namespace internals {
+      class ServicesServerPrivate;
+   };
+   class ServicesManager;
+
+   /**
+    * @brief TCP server attaching accepted connections to ServicesManager.
+    *
+    * This class owns QTcpServer listening for incoming connections. Each
+    * accepted connection is added to a ServicesManager instance with
+    * ServicesManager::addDevice(QIODevice *) and the socket is deleted as soon
+    * as it's disconnected so there is no need to poll for closed sockets.
+    *
+    * Simple server application looks like:
+    * @code
+    * qrs::ServicesManager *manager = new qrs::ServicesManager(&app);
+    * new qrs::MyService(manager);
+    * qrs::ServicesServer *server = new qrs::ServicesServer(manager, &app);
+    * server->listen(QHostAddress::Any, 8081);
+    * @endcode
+    *
+    * Connections can be sharded across several managers living in different
+    * threads. Each new connection is attached to the manager having the least
+    * number of live connections. Socket is created in the thread of the
+    * manager it is attached to:
+    * @code
+    * for (int i = 0; i < QThread::idealThreadCount(); i++) {
+    *     QThread *worker = new QThread(&app);
+    *     qrs::ServicesManager *manager = new qrs::ServicesManager;
+    *     new qrs::MyService(manager);
+    *     manager->moveToThread(worker);
+    *     server->addManager(manager);
+    *     worker->start();
+    * }
+    * @endcode
+    *
+    * @note Statistics and settings of this class should be accessed from the
+    * thread this object lives in.
+    *
+    * @sa ServicesManager::addDevice(QIODevice *)
+    */
+   class QRS_EXPORT ServicesServer : public QObject {
+      Q_OBJECT
+      Q_DISABLE_COPY(ServicesServer);
+      public:
+         explicit ServicesServer(ServicesManager *manager, QObject *parent = 0);
+         virtual ~ServicesServer();
+
+         /// @brief Add manager to shard connections across
+         void addManager(ServicesManager *manager);
+         /// @brief Number of managers connections are sharded across
+         int managersCount() const;
+
+         /// @brief Start listening for the incoming connections
+         bool listen(const QHostAddress &address = QHostAddress::Any,
+                     quint16 port = 0);
+         /// @brief Stop listening. Established connections are not closed.
+         void close();
+         bool isListening() const;
+         quint16 serverPort() const;
+         QHostAddress serverAddress() const;
+         QString errorString() const;
+
+         /// @brief Maximum number of simultaneous connections
+         int maxConnections() const;
+         /// @brief Maximum number of simultaneous connections
+         void setMaxConnections(int val);
+
+         /// @brief Number of live connections
+         int connectionsCount() const;
+         /// @brief Total number of accepted connections
+         quint64 acceptedCount() const;
+         /// @brief Total number of connections rejected due to the limit
+         quint64 rejectedCount() const;
+         /// @brief Connections accepted during the last full second
+         int acceptRate() const;
+
+      signals:
+         /**
+          * This signal is emitted if incoming connection was closed
+          * immediately because maxConnections() limit is reached.
+          */
+         void connectionRejected();
+
+      private:
+         internals::ServicesServerPrivate *const d;
+         friend class internals::ServicesServerPrivate;
+
+      private slots:
+         void onRateTimer();
+   };
+
+}
+
+#endif
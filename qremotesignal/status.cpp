@@ -0,0 +1,28 @@
+/**
+ * @file status.cpp
+ * @brief Status class implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "status.h"
+
+#include <QtCore/QCoreApplication>
+
+using namespace qrs;
+
+QString Status::detail() const {
+   if ( mFormat == 0 ) {
+      return mArg1.toString();
+   }
+   QString res = QCoreApplication::translate(mContext, mFormat);
+   // Both arguments are substituted at once so placeholders inside of the
+   // first argument are kept as is
+   if ( res.contains("%2") ) {
+      return res.arg(mArg1.toString(), mArg2.toString());
+   }
+   if ( res.contains("%1") ) {
+      return res.arg(mArg1.toString());
+   }
+   return res;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file status.h
+ * @brief Status class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _Status_H
+#define _Status_H
+
+#include <QtCore/QString>
+#include <QtCore/QVariant>
+
+#include "qrsexport.h"
+#include "message.h"
+
+namespace qrs {
+
+   /**
+    * @brief Result of the message deserialization or processing.
+    *
+    * Non throwing alternative to MessageParsingException and
+    * IncorrectMethodException. Status stores error code and a pointer to the
+    * untranslated error description format with up to two arguments. The
+    * description is translated and formatted only when detail() is called so
+    * rejecting malformed message costs almost the same as processing a
+    * correct one. Numeric arguments are converted to strings by detail() as
+    * well.
+    *
+    * Format and translation context strings should have static storage
+    * duration (string literals) since status doesn't copy them. Formats are
+    * translated in the "QObject" context unless the context is given. Mark
+    * them with QT_TRANSLATE_NOOP to make them available for translation.
+    * Services generated by qrsc use "AbsService" context.
+    */
+   class QRS_EXPORT Status {
+      public:
+         Status(): mCode(Message::Ok), mContext(0), mFormat(0) {}
+         Status(Message::ErrorType code, const char *format,
+                const QVariant &arg1 = QVariant(), const QVariant &arg2 = QVariant()):
+            mCode(code), mContext("QObject"), mFormat(format),
+            mArg1(arg1), mArg2(arg2) {}
+         /// @brief Status with format translated in the @a context
+         Status(Message::ErrorType code, const char *context, const char *format,
+                const QVariant &arg1, const QVariant &arg2 = QVariant()):
+            mCode(code), mContext(context), mFormat(format),
+            mArg1(arg1), mArg2(arg2) {}
+         /// @brief Status with already formatted error description
+         Status(Message::ErrorType code, const QString &detail):
+            mCode(code), mContext(0), mFormat(0), mArg1(detail) {}
+
+         bool isOk() const {return mCode == Message::Ok;}
+         Message::ErrorType code() const {return mCode;}
+         /// @brief Translated and formatted error description
+         QString detail() const;
+
+      private:
+         Message::ErrorType mCode;
+         const char *mContext;
+         const char *mFormat;
+         QVariant mArg1, mArg2;
+   };
+
+}
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file threaddispatcher.cpp
+ * @brief ThreadDispatcher implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "threaddispatcher.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMetaObject>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+#include "absservice.h"
+#include "servicesmanager.h"
+#include "status.h"
+
+using namespace qrs;
+using namespace qrs::internals;
+
+// Registry is used only to find dispatcher of a thread for the first time.
+// ServicesManager caches the dispatchers it uses.
+static QMutex registryMutex;
+static QHash<QThread*, ThreadDispatcher*> registry;
+
+// fetchAndAddAcquire(0) and fetchAndStoreRelease give the same ordering
+// guarantees on Qt4 which has no plain acquire loads and release stores.
+static DispatchItem *loadAcquire(QAtomicPointer<DispatchItem> &ptr)
+{
+    return ptr.fetchAndAddAcquire(0);
+}
+
+static void storeRelease(QAtomicPointer<DispatchItem> &ptr, DispatchItem *val)
+{
+    ptr.fetchAndStoreRelease(val);
+}
+
+ThreadDispatcher::ThreadDispatcher():
+        QObject(0),
+        mHead(&mStub),
+        mTail(&mStub),
+        mScheduled(0)
+{
+}
+
+ThreadDispatcher::~ThreadDispatcher()
+{
+    DispatchItem *item;
+    while ((item = pop()) != 0) {
+        delete item;
+    }
+}
+
+/**
+ * Creates dispatcher on the first request. Dispatcher is moved to the
+ * @a thread so it must be called before the thread finishes.
+ */
+ThreadDispatcher *ThreadDispatcher::forThread(QThread *thread)
+{
+    QMutexLocker locker(&registryMutex);
+    ThreadDispatcher *res = registry.value(thread, 0);
+    if (res == 0) {
+        res = new ThreadDispatcher;
+        res->moveToThread(thread);
+        // Direct since thread has no event loop when it emits finished
+        connect(thread, SIGNAL(finished()),
+                res, SLOT(onThreadFinished()), Qt::DirectConnection);
+        registry.insert(thread, res);
+    }
+    return res;
+}
+
+void ThreadDispatcher::post(DispatchItem *item)
+{
+    push(item);
+    if (mScheduled.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+    }
+}
+
+void ThreadDispatcher::push(DispatchItem *item)
+{
+    storeRelease(item->next, 0);
+    DispatchItem *prev = mHead.fetchAndStoreAcqRel(item);
+    storeRelease(prev->next, item);
+}
+
+/**
+ * @return next item or 0 if the queue is empty or the producer adding next
+ * item has not linked it yet. Such item is processed by the next drain
+ * since producer posts it after linking.
+ */
+DispatchItem *ThreadDispatcher::pop()
+{
+    DispatchItem *tail = mTail;
+    DispatchItem *next = loadAcquire(tail->next);
+    if (tail == &mStub) {
+        if (next == 0) {
+            return 0;
+        }
+        mTail = next;
+        tail = next;
+        next = loadAcquire(next->next);
+    }
+    if (next != 0) {
+        mTail = next;
+        return tail;
+    }
+    if (tail != mHead.fetchAndAddAcquire(0)) {
+        return 0;
+    }
+    push(&mStub);
+    next = loadAcquire(tail->next);
+    if (next != 0) {
+        mTail = next;
+        return tail;
+    }
+    return 0;
+}
+
+/**
+ * Processes all the items in the queue. Errors are replied by the manager
+ * in its own thread. Batch signals of the services are emitted after all
+ * the items are processed.
+ */
+void ThreadDispatcher::drain()
+{
+    // Reset before reading so item posted during drain schedules next one
+    mScheduled.fetchAndStoreOrdered(0);
+    QList< QPointer<AbsService> > touched;
+    DispatchItem *item;
+    while ((item = pop()) != 0) {
+        AbsService *service = item->service;
+        if (service != 0) {
+            Status status;
+            service->processMessage(*item->msg, status);
+            if (!status.isOk() && item->manager) {
+                QMetaObject::invokeMethod(item->manager, "onDispatchError",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(QObject*, item->source),
+                                          Q_ARG(int, status.code()),
+                                          Q_ARG(QString, status.detail()),
+                                          Q_ARG(QString, item->msg->service()),
+                                          Q_ARG(QString, item->msg->method()));
+            }
+            if (!touched.contains(item->service)) {
+                touched.append(item->service);
+            }
+        }
+        delete item;
+    }
+    foreach (const QPointer<AbsService> &service, touched) {
+        if (service) {
+            service->flushBatches();
+        }
+    }
+}
+
+void ThreadDispatcher::onThreadFinished()
+{
+    {
+        QMutexLocker locker(&registryMutex);
+        registry.remove(thread());
+    }
+    // Deferred deletes are processed by the finishing thread after finished
+    deleteLater();
+}
@@ -0,0 +1,95 @@
+/**
+ * @file threaddispatcher.h
+ * @brief ThreadDispatcher class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _ThreadDispatcher_H
+#define _ThreadDispatcher_H
+
+#include <QtCore/QtGlobal>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+
+#include "message.h"
+
+class QThread;
+
+namespace qrs {
+
+class AbsService;
+class ServicesManager;
+
+namespace internals {
+
+/**
+ * @internal
+ *
+ * Decoded message passed to the thread of the service. Item owns the
+ * message and is owned by the queue while it's there.
+ */
+struct DispatchItem {
+    DispatchItem(): next(0), msg(0), source(0) {}
+    ~DispatchItem() {delete msg;}
+
+    QAtomicPointer<DispatchItem> next;
+    Message *msg;
+    QPointer<AbsService> service;
+    QPointer<ServicesManager> manager;
+    /// DeviceManager the message came from. Used as a key only.
+    QObject *source;
+};
+
+/**
+ * @internal
+ *
+ * Lock-free multiple producers single consumer queue of messages for the
+ * services living in one thread. Any thread can post items while the
+ * dispatcher thread processes them calling AbsService::processMessage
+ * directly so signals of the service are emitted in its own thread without
+ * copying arguments into queued events.
+ *
+ * Intrusive queue with a stub node (D. Vyukov) is used. Producers only swap
+ * the head pointer. The only event per burst of messages is posted to the
+ * dispatcher thread when the queue becomes non empty.
+ *
+ * There is one dispatcher per thread. It's deleted when its thread
+ * finishes dropping messages left in the queue.
+ */
+class ThreadDispatcher : public QObject {
+Q_OBJECT
+Q_DISABLE_COPY(ThreadDispatcher);
+public:
+    /// @brief Dispatcher of the given thread. Thread safe.
+    static ThreadDispatcher *forThread(QThread *thread);
+
+    /// @brief Pass item to the dispatcher thread. Thread safe.
+    void post(DispatchItem *item);
+
+private slots:
+    void drain();
+    void onThreadFinished();
+
+private:
+    ThreadDispatcher();
+    ~ThreadDispatcher();
+
+    void push(DispatchItem *item);
+    DispatchItem *pop();
+
+    /// Last item posted. Swapped by producers.
+    QAtomicPointer<DispatchItem> mHead;
+    /// Next item to be processed. Used by the consumer only.
+    DispatchItem *mTail;
+    DispatchItem mStub;
+    /// Set while drain is posted to the dispatcher thread
+    QAtomicInt mScheduled;
+};
+
+} // namespace internals
+} // namespace qrs
+
+#endif
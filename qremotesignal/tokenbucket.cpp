@@ -0,0 +1,88 @@
+/**
+ * @file tokenbucket.cpp
+ * @brief TokenBucket implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "tokenbucket.h"
+
+#include <cmath>
+
+#if QT_VERSION >= 0x040700
+#include <QtCore/QElapsedTimer>
+#else
+#include <QtCore/QTime>
+#endif
+
+using namespace qrs::internals;
+
+#if QT_VERSION >= 0x040700
+static QElapsedTimer startedTimer()
+{
+    QElapsedTimer res;
+    res.start();
+    return res;
+}
+#endif
+
+void TokenBucket::setLimit(double rate, int burst)
+{
+    mRate = qMax(rate, 0.0);
+    mBurst = qMax(burst, 1);
+    mTokens = mBurst;
+    mLast = clock();
+}
+
+bool TokenBucket::take(bool debt)
+{
+    if (!isLimited()) {
+        return true;
+    }
+    qint64 now = clock();
+    mTokens = qMin(double(mBurst), mTokens + (now - mLast)*mRate/1000.0);
+    mLast = now;
+    if (mTokens >= 1.0) {
+        mTokens -= 1.0;
+        return true;
+    }
+    if (debt) {
+        mTokens -= 1.0;
+    }
+    return false;
+}
+
+int TokenBucket::waitTime() const
+{
+    if (!isLimited()) {
+        return 0;
+    }
+    double tokens = mTokens + (clock() - mLast)*mRate/1000.0;
+    if (tokens >= 1.0) {
+        return 0;
+    }
+    return int(std::ceil((1.0 - tokens)*1000.0/mRate));
+}
+
+qint64 TokenBucket::clock()
+{
+#if QT_VERSION >= 0x040700
+    static const QElapsedTimer timer = startedTimer();
+    return timer.elapsed();
+#else
+    // QTime wraps at midnight. Wraps are counted so the time keeps growing.
+    // Not monotonic if system time changes which is acceptable for old Qt.
+    static QTime timer;
+    static qint64 wraps = 0;
+    static int last = 0;
+    if (timer.isNull()) {
+        timer.start();
+    }
+    int elapsed = timer.elapsed();
+    if (elapsed < last) {
+        wraps++;
+    }
+    last = elapsed;
+    return wraps*86400000 + elapsed;
+#endif
+}
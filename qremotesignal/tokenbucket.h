@@ -0,0 +1,58 @@
+/**
+ * @file tokenbucket.h
+ * @brief TokenBucket class
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _TokenBucket_H
+#define _TokenBucket_H
+
+#include <QtCore/QtGlobal>
+
+namespace qrs {
+namespace internals {
+
+/**
+ * @internal
+ *
+ * Token bucket rate limiter. Bucket is refilled with @a rate tokens per
+ * second up to @a burst tokens. Refill is calculated lazily when a token is
+ * taken so idle buckets cost nothing.
+ */
+class TokenBucket {
+public:
+    TokenBucket(): mRate(0), mBurst(0), mTokens(0), mLast(0) {}
+
+    /// @brief Sets limit and fills the bucket. Zero rate disables limit.
+    void setLimit(double rate, int burst);
+    bool isLimited() const {return mRate > 0;}
+    double rate() const {return mRate;}
+    int burst() const {return mBurst;}
+
+    /**
+     * Takes one token.
+     *
+     * @param debt take the token even if bucket is empty. Bucket needs more
+     * time to refill in this case.
+     *
+     * @return false if there was no token in the bucket.
+     */
+    bool take(bool debt = false);
+    /// @brief Milliseconds until the bucket has at least one token.
+    int waitTime() const;
+
+    /// @brief Monotonic time in milliseconds.
+    static qint64 clock();
+
+private:
+    double mRate;
+    int mBurst;
+    double mTokens;
+    qint64 mLast;
+};
+
+} // namespace internals
+} // namespace qrs
+
+#endif
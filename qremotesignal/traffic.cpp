@@ -0,0 +1,257 @@
+/**
+ * @file traffic.cpp
+ * @brief TrafficRecorder and TrafficReplay classes implementation
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include "traffic.h"
+
+#include <cstring>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QtAlgorithms>
+#include <QtCore/QtEndian>
+#if QT_VERSION >= 0x040800
+#include <QtCore/QElapsedTimer>
+#endif
+
+#include "servicesmanager.h"
+#include "status.h"
+#include "tokenbucket.h"
+
+using namespace qrs;
+
+namespace {
+
+   /// QThread::usleep is protected in Qt4
+   class Sleeper: public QThread {
+      public:
+         static void sleep(qint64 usecs) {QThread::usleep((unsigned long)usecs);}
+   };
+
+#if QT_VERSION >= 0x040800
+   QElapsedTimer startedTimer() {
+      QElapsedTimer res;
+      res.start();
+      return res;
+   }
+#endif
+
+   /// Monotonic time in microseconds
+   qint64 usecs() {
+#if QT_VERSION >= 0x040800
+      static const QElapsedTimer timer = startedTimer();
+      return timer.nsecsElapsed()/1000;
+#else
+      return internals::TokenBucket::clock()*1000;
+#endif
+   }
+
+   /// Microseconds since the Epoch
+   qint64 wallClock() {
+#if QT_VERSION >= 0x040700
+      return QDateTime::currentMSecsSinceEpoch()*1000;
+#else
+      return qint64(QDateTime::currentDateTime().toUTC().toTime_t())*1000000;
+#endif
+   }
+
+   /**
+    * Sleeps until the monotonic clock reaches @a due processing events
+    * posted to the thread at least every 10 milliseconds. Last millisecond
+    * is spent spinning since sleep is not precise enough.
+    */
+   void waitUntil(qint64 due) {
+      qint64 left = due - usecs();
+      while ( left > 0 ) {
+         QCoreApplication::processEvents();
+         if ( left > 1000 ) {
+            Sleeper::sleep(qMin(left - 1000, qint64(10000)));
+         }
+         left = due - usecs();
+      }
+   }
+
+}
+
+const char *TrafficRecorder::signature() {
+   return "QRSTRAF1";
+}
+
+TrafficRecorder::TrafficRecorder(const QString &path):
+      mFile(path), mBase(0), mStart(0) {
+}
+
+/**
+ * Opens the file for appending. New file gets the signature written.
+ *
+ * @return false if the file can't be opened or is not a traffic record.
+ */
+bool TrafficRecorder::open() {
+   if ( mFile.isOpen() ) {
+      return true;
+   }
+   if ( mFile.exists() && mFile.size() > 0 ) {
+      QFile check(mFile.fileName());
+      if ( !check.open(QIODevice::ReadOnly) ||
+           check.read(SIGNATURE_SIZE) != QByteArray(signature()) ) {
+         return false;
+      }
+   }
+   if ( !mFile.open(QIODevice::WriteOnly | QIODevice::Append) ) {
+      return false;
+   }
+   if ( mFile.size() == 0 ) {
+      mFile.write(signature(), SIGNATURE_SIZE);
+   }
+   mBase = wallClock();
+   mStart = usecs();
+   return true;
+}
+
+void TrafficRecorder::close() {
+   mFile.close();
+}
+
+/**
+ * Appends message to the file. Does nothing if the recorder is not opened.
+ */
+void TrafficRecorder::record(Direction direction, quint32 device,
+                             const QByteArray &msg) {
+   if ( !mFile.isOpen() ) {
+      return;
+   }
+   uchar header[HEADER_SIZE];
+   qToBigEndian<quint64>(mBase + usecs() - mStart, header);
+   qToBigEndian<quint32>(device, header + 8);
+   header[12] = uchar(direction);
+   qToBigEndian<quint32>(msg.size(), header + 13);
+   mFile.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+   mFile.write(msg);
+}
+
+TrafficReplay::TrafficReplay(const QString &path):
+      mFile(path), mData(0), mSize(0) {
+}
+
+/**
+ * Maps the file into memory.
+ *
+ * @return false if the file can't be mapped or is not a traffic record.
+ */
+bool TrafficReplay::open() {
+   if ( mData != 0 ) {
+      return true;
+   }
+   if ( !mFile.open(QIODevice::ReadOnly) ) {
+      mError = mFile.errorString();
+      return false;
+   }
+   mSize = mFile.size();
+   if ( mSize < TrafficRecorder::SIGNATURE_SIZE ) {
+      mError = QObject::tr("File is not a traffic record");
+      mFile.close();
+      return false;
+   }
+   mData = mFile.map(0, mSize);
+   if ( mData == 0 ) {
+      mError = mFile.errorString();
+      mFile.close();
+      return false;
+   }
+   if ( std::memcmp(mData, TrafficRecorder::signature(),
+                    TrafficRecorder::SIGNATURE_SIZE) != 0 ) {
+      mError = QObject::tr("File is not a traffic record");
+      close();
+      return false;
+   }
+   return true;
+}
+
+void TrafficReplay::close() {
+   if ( mData != 0 ) {
+      mFile.unmap(const_cast<uchar*>(mData));
+      mData = 0;
+   }
+   mFile.close();
+}
+
+/**
+ * Passes received messages from the file to the ServicesManager::receive()
+ * slot of the @a manager.
+ *
+ * @param speed 1.0 replays at the recorded speed, 2.0 twice as fast and so
+ * on. 0 replays as fast as possible.
+ * @param device replay only messages received from the device with this id.
+ * Negative value replays messages of all devices.
+ */
+ReplayStats TrafficReplay::replay(ServicesManager *manager, double speed,
+                                  qint64 device) {
+   ReplayStats res;
+   if ( mData == 0 || manager == 0 ) {
+      return res;
+   }
+   QVector<qint64> latencies;
+   qint64 first = -1;
+   const qint64 start = usecs();
+   qint64 pos = TrafficRecorder::SIGNATURE_SIZE;
+   while ( pos + TrafficRecorder::HEADER_SIZE <= mSize ) {
+      const uchar *header = mData + pos;
+      const qint64 time = qint64(qFromBigEndian<quint64>(header));
+      const quint32 dev = qFromBigEndian<quint32>(header + 8);
+      const quint8 direction = header[12];
+      const quint32 size = qFromBigEndian<quint32>(header + 13);
+      pos += TrafficRecorder::HEADER_SIZE;
+      // Record was not completely written
+      if ( qint64(size) > mSize - pos ) {
+         break;
+      }
+      const char *data = reinterpret_cast<const char*>(mData + pos);
+      pos += size;
+      if ( direction != TrafficRecorder::Received ||
+           (device >= 0 && qint64(dev) != device) ) {
+         continue;
+      }
+
+      qint64 due = 0;
+      if ( speed > 0 ) {
+         if ( first < 0 ) {
+            first = time;
+         }
+         due = start + qint64((time - first)/speed);
+         waitUntil(due);
+      }
+      // Lazily decoded params keep the message data which must outlive
+      // the mapping, so it is copied before the time is measured.
+      const QByteArray msg(data, size);
+      const qint64 begin = usecs();
+      if ( speed > 0 ) {
+         res.maxLag = qMax(res.maxLag, begin - due);
+      }
+      Status status = manager->receive(msg);
+      const qint64 latency = usecs() - begin;
+      latencies.append(latency);
+      res.messages++;
+      res.bytes += size;
+      if ( !status.isOk() ) {
+         res.errors++;
+      }
+   }
+   res.duration = usecs() - start;
+   if ( latencies.isEmpty() ) {
+      return res;
+   }
+   qint64 total = 0;
+   foreach (qint64 latency, latencies) {
+      total += latency;
+   }
+   qSort(latencies);
+   res.meanLatency = double(total)/latencies.size();
+   res.p99Latency = latencies[qMin(latencies.size() - 1, latencies.size()*99/100)];
+   res.maxLatency = latencies.last();
+   return res;
+}
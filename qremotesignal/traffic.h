@@ -0,0 +1,136 @@
+/**
+ * @file traffic.h
+ * @brief TrafficRecorder and TrafficReplay classes
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#ifndef _Traffic_H
+#define _Traffic_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+#include "qrsexport.h"
+
+namespace qrs {
+
+   class ServicesManager;
+
+   /**
+    * @brief Appends raw messages passing through a ServicesManager to a file.
+    *
+    * Set recorder with ServicesManager::setRecorder() to capture real
+    * traffic and replay it later with TrafficReplay for load testing. File
+    * starts with 8 bytes "QRSTRAF1" signature followed by records:
+    * @li quint64 time in microseconds since the Epoch;
+    * @li quint32 device id (0 for messages passing through
+    * ServicesManager::receive() and ServicesManager::send(QByteArray));
+    * @li quint8 direction (see Direction);
+    * @li quint32 message size followed by the raw message.
+    *
+    * All numbers are big endian. File is opened in append mode so several
+    * sessions can be recorded to the same file and partially written record
+    * left after a crash only ends the replay.
+    */
+   class QRS_EXPORT TrafficRecorder {
+      public:
+         enum Direction {
+            /// Message received from the peer
+            Received = 0,
+            /// Message sent to the peer
+            Sent = 1
+         };
+
+         explicit TrafficRecorder(const QString &path);
+         ~TrafficRecorder() {close();}
+
+         bool open();
+         void close();
+         bool isOpen() const {return mFile.isOpen();}
+         QString errorString() const {return mFile.errorString();}
+         /// @brief Write buffered records to the file
+         void flush() {mFile.flush();}
+
+         void record(Direction direction, quint32 device, const QByteArray &msg);
+
+         /// @brief Size of the file signature
+         static const int SIGNATURE_SIZE = 8;
+         /// @brief Size of the record header preceding the message
+         static const int HEADER_SIZE = 17;
+         /// @brief File signature
+         static const char *signature();
+
+      private:
+         Q_DISABLE_COPY(TrafficRecorder);
+
+         QFile mFile;
+         /// Wall clock time of open() call in microseconds
+         qint64 mBase;
+         /// Monotonic clock value of open() call in microseconds
+         qint64 mStart;
+   };
+
+   /**
+    * @brief Result of TrafficReplay::replay() call.
+    *
+    * Latency is the time spent in ServicesManager::receive() for a single
+    * message. Lag is the delay of the message delivery relative to its
+    * recorded time scaled by the replay speed. All times are in
+    * microseconds.
+    */
+   struct QRS_EXPORT ReplayStats {
+      ReplayStats(): messages(0), bytes(0), errors(0), duration(0),
+                     meanLatency(0), p99Latency(0), maxLatency(0), maxLag(0) {}
+
+      /// @brief Messages per second
+      double throughput() const {
+         return duration > 0 ? messages*1000000.0/duration : 0;
+      }
+
+      quint64 messages;
+      quint64 bytes;
+      /// Messages ServicesManager failed to process
+      quint64 errors;
+      qint64 duration;
+      double meanLatency;
+      qint64 p99Latency;
+      qint64 maxLatency;
+      qint64 maxLag;
+   };
+
+   /**
+    * @brief Feeds traffic recorded by TrafficRecorder to a ServicesManager.
+    *
+    * File is memory mapped and each message is copied out of the mapping
+    * before it is passed to the ServicesManager::receive() since messages
+    * may keep their data after the replay. The copy isn't included in the
+    * measured latency. Only received messages are replayed. Sent ones are
+    * skipped.
+    */
+   class QRS_EXPORT TrafficReplay {
+      public:
+         explicit TrafficReplay(const QString &path);
+         ~TrafficReplay() {close();}
+
+         bool open();
+         void close();
+         bool isOpen() const {return mData != 0;}
+         QString errorString() const {return mError;}
+
+         ReplayStats replay(ServicesManager *manager, double speed = 1.0,
+                            qint64 device = -1);
+
+      private:
+         Q_DISABLE_COPY(TrafficReplay);
+
+         QFile mFile;
+         const uchar *mData;
+         qint64 mSize;
+         QString mError;
+   };
+
+}
+
+#endif
@@ -10,70 +10,725 @@
 #include <QtCore/QFile>
 #include <QtCore/QIODevice>
 #include <QtCore/QFileInfo>
-
-#include <QtXmlPatterns/QXmlQuery>
+#include <QtCore/QTextStream>
 
 #include "config.h"
-#include "qtextserializer.h"
 
-bool InterfaceCompiler::compileServiceHeader() {
-   QFile xsltFile(":/ServiceHeader.xsl");
-   QFile out(mInterface->serviceHeader());
-   xsltFile.open(QIODevice::ReadOnly | QIODevice::Text);
-   out.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate);
+/// Value used for optional param or field absent in the message
+static QString defaultValue(const InterfaceParam &param) {
+   if ( param.defaultValue.isEmpty() ) {
+      return param.type + "()";
+   }
+   return param.defaultValue;
+}
 
-   return xsltTransformation(out,xsltFile);
+/**
+ * "const T1& a, const T2& b" or "T1 a, T2 b" list for the declaration. If
+ * withDefaults is true trailing optional params get default arguments so
+ * the code calling the function compiles after optional param is added.
+ */
+static QString paramsDeclaration(const InterfaceMethod &method, bool constRefs,
+                                 bool withDefaults = false) {
+   int firstDefault = method.params.size();
+   while ( withDefaults && firstDefault > 0 && method.params[firstDefault-1].optional ) {
+      firstDefault--;
+   }
+   QString res;
+   for (int i = 0; i < method.params.size(); i++) {
+      if ( i > 0 ) {
+         res += ", ";
+      }
+      if ( constRefs ) {
+         res += "const " + method.params[i].type + "& " + method.params[i].name;
+      } else {
+         res += method.params[i].type + " " + method.params[i].name;
+      }
+      if ( i >= firstDefault ) {
+         res += " = " + defaultValue(method.params[i]);
+      }
+   }
+   return res;
 }
 
-bool InterfaceCompiler::compileServiceSource() {
-   QFile xsltFile(":/ServiceSource.xsl");
-   QFile out(mInterface->serviceSource());
-   xsltFile.open(QIODevice::ReadOnly | QIODevice::Text);
-   out.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate);
+/// "a, b" list for the call
+static QString argsList(const InterfaceMethod &method) {
+   QString res;
+   for (int i = 0; i < method.params.size(); i++) {
+      if ( i > 0 ) {
+         res += ", ";
+      }
+      res += method.params[i].name;
+   }
+   return res;
+}
 
-   return xsltTransformation(out,xsltFile);
+static QString capitalized(const QString &name) {
+   if ( name.isEmpty() ) {
+      return name;
+   }
+   return name.left(1).toUpper() + name.mid(1);
 }
 
-bool InterfaceCompiler::compileClientHeader() {
-   QFile xsltFile(":/ClientHeader.xsl");
-   QFile out(mInterface->clientHeader());
-   xsltFile.open(QIODevice::ReadOnly | QIODevice::Text);
-   out.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate);
+/// Structure holding params of one call delivered with the batch signal
+static QString argsStruct(const QString &className, const InterfaceMethod &method) {
+   return "qrs::" + className + "::" + capitalized(method.name) + "Args";
+}
 
-   return xsltTransformation(out,xsltFile);
+/// Calls waiting for the batch signal
+static QString batchMember(const InterfaceMethod &method) {
+   return "m" + capitalized(method.name) + "Batch";
+}
+
+static bool hasBatches(const QList<InterfaceMethod> &methods) {
+   foreach (const InterfaceMethod &method, methods) {
+      if ( method.batch ) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/// Prebuilt method name constant used by the generated code
+static QString methodName(const QString &name) {
+   return "methodName_" + name;
+}
+
+/// Prebuilt param key constant used by the generated code
+static QString paramName(const QString &name) {
+   return "paramName_" + name;
+}
+
+/**
+ * Writes file local constants for all method names and param keys. QString
+ * is implicitly shared so setting such constant to a message costs only
+ * reference counter increment while string literal is converted with memory
+ * allocation on each call.
+ */
+static void writeNames(QTextStream &out, const InterfaceDocument *interface) {
+   QList<InterfaceMethod> methods = interface->remoteSlots() + interface->remoteSignals();
+   QStringList methodNames;
+   QStringList paramNames;
+   foreach (const InterfaceMethod &method, methods) {
+      if ( !methodNames.contains(method.name) ) {
+         methodNames.append(method.name);
+      }
+      foreach (const InterfaceParam &param, method.params) {
+         if ( !paramNames.contains(param.name) ) {
+            paramNames.append(param.name);
+         }
+      }
+   }
+   out << "namespace {\n";
+   foreach (const QString &name, methodNames) {
+      out << "   const QString " << methodName(name) << "(\"" << name << "\");\n";
+   }
+   foreach (const QString &name, paramNames) {
+      out << "   const QString " << paramName(name) << "(\"" << name << "\");\n";
+   }
+   out << "}\n\n";
+}
+
+/**
+ * Sends method call message. Used by service signals and client slots.
+ * Message is not even built if nobody can get it.
+ */
+static void writeSender(QTextStream &out, const QString &className,
+                        const InterfaceMethod &method) {
+   out << "void " << className << "::" << method.name << "("
+       << paramsDeclaration(method, true) << ") {\n"
+       << "   if ( manager() == 0 || !manager()->hasConsumers() ) {\n"
+       << "      return;\n"
+       << "   }\n"
+       << "   Message msg;\n"
+       << "   msg.setMethod(" << methodName(method.name) << ");\n"
+       << "   msg.setService(mName);\n";
+   foreach (const InterfaceParam &param, method.params) {
+      out << "   msg.params().insert(" << paramName(param.name) << ",qrs::createArg("
+          << param.name << "));\n";
+   }
+   out << "   manager()->send(msg);\n"
+       << "}\n\n";
+}
+
+/// "T1,T2" list for the SIGNAL() macro
+static QString signalSignature(const InterfaceMethod &method) {
+   QStringList types;
+   foreach (const InterfaceParam &param, method.params) {
+      types.append(param.type);
+   }
+   return method.name + "(" + types.join(",") + ")";
+}
+
+/**
+ * Processes method call message. Used by service slots and client signals.
+ * Errors are reported with qrs::Status holding untranslated format and its
+ * arguments so rejecting malformed message costs neither exception nor
+ * string formatting. Throwing version is a wrapper kept for compatibility.
+ *
+ * If @a skipUnconnected is set message for the signal nobody is connected to
+ * is accepted without looking into its params so they are never decoded.
+ * Client uses it for the signals it is not interested in while service
+ * still validates the call to report malformed one back to the caller.
+ */
+static void writeProcessMessage(QTextStream &out, const QString &className,
+                                const QList<InterfaceMethod> &methods,
+                                bool skipUnconnected) {
+   out << "void " << className << "::processMessage (const Message& msg)\n"
+       << "      throw(IncorrectMethodException) {\n"
+       << "   Status status;\n"
+       << "   processMessage(msg, status);\n"
+       << "   if ( !status.isOk() ) {\n"
+       << "      throw( IncorrectMethodException(status.detail()) );\n"
+       << "   }\n"
+       << "}\n"
+       << "\n"
+       << "void " << className << "::processMessage (const Message& msg, Status &status) {\n"
+       << "   if ( msg.service() != mName ) {\n"
+       << "      status = Status(Message::IncorrectMethod, \"AbsService\", QT_TRANSLATE_NOOP(\"AbsService\", \"Invalid service name: %1\"), msg.service());\n"
+       << "      return;\n"
+       << "   }\n";
+   foreach (const InterfaceMethod &method, methods) {
+      out << "\n   if ( msg.method() == " << methodName(method.name) << " ) {";
+      if ( skipUnconnected ) {
+         out << "\n      if ( receivers(SIGNAL(" << signalSignature(method) << ")) == 0";
+         if ( method.batch ) {
+            out << " &&\n           receivers(SIGNAL(" << method.name << "Batch(QList<"
+                << argsStruct(className, method) << ">))) == 0";
+         }
+         out << " ) {\n"
+             << "         return;\n"
+             << "      }";
+      }
+      if ( !method.params.isEmpty() ) {
+         out << "\n      if ( msg.paramsCorrupted() ) {\n"
+             << "         status = Status(Message::ProtocolError, \"AbsService\", QT_TRANSLATE_NOOP(\"AbsService\", \"Corrupted params of method %1\"), msg.method());\n"
+             << "         return;\n"
+             << "      }";
+      }
+      foreach (const InterfaceParam &param, method.params) {
+         const QString it = "qrsIt_" + param.name;
+         out << "\n      " << param.type << " " << param.name << ";\n"
+             << "      QVariantMap::const_iterator " << it << " = msg.params().constFind("
+             << paramName(param.name) << ");\n"
+             << "      if ( " << it << " == msg.params().constEnd() ) {\n";
+         if ( param.optional ) {
+            // Sent by the peer using older interface version
+            out << "         " << param.name << " = " << defaultValue(param) << ";\n"
+                << "      } else if ( !qrs::getArgValue(" << it << ".value(), "
+                << param.name << ") ) {\n";
+         } else {
+            out << "         status = Status(Message::IncorrectMethod, \"AbsService\", QT_TRANSLATE_NOOP(\"AbsService\", \"Message doesn't contain param \\\"%1\\\" required to call method \\\"%2\\\"\"), "
+                << paramName(param.name) << ", msg.method());\n"
+                << "         return;\n"
+                << "      }\n"
+                << "      if ( !qrs::getArgValue(" << it << ".value(), "
+                << param.name << ") ) {\n";
+         }
+         out << "         status = Status(Message::IncorrectMethod, \"AbsService\", QT_TRANSLATE_NOOP(\"AbsService\", \"Can't obtain \\\"%1\\\" param value\"), "
+             << paramName(param.name) << ");\n"
+             << "         return;\n"
+             << "      }";
+      }
+      if ( method.batch ) {
+         // Collected until the end of the read pass if anyone waits for them
+         out << "\n      if ( receivers(SIGNAL(" << method.name << "Batch(QList<"
+             << argsStruct(className, method) << ">))) > 0 ) {\n"
+             << "         " << argsStruct(className, method) << " qrsArgs;\n";
+         foreach (const InterfaceParam &param, method.params) {
+            out << "         qrsArgs." << param.name << " = " << param.name << ";\n";
+         }
+         out << "         " << batchMember(method) << ".append(qrsArgs);\n"
+             << "         return;\n"
+             << "      }";
+      }
+      out << "\n      emit " << method.name << "( " << argsList(method) << " );\n"
+          << "      return;\n"
+          << "   }";
+   }
+   out << "\n\n   status = Status(Message::IncorrectMethod, \"AbsService\", QT_TRANSLATE_NOOP(\"AbsService\", \"Unknown method %1\"), msg.method());\n"
+       << "}\n";
+}
+
+/**
+ * Emits batch signals with the calls collected by processMessage. Batch is
+ * detached from the member before emitting so the handler can process
+ * messages which start the next batch.
+ */
+static void writeFlushBatches(QTextStream &out, const QString &className,
+                              const QList<InterfaceMethod> &methods) {
+   if ( !hasBatches(methods) ) {
+      return;
+   }
+   out << "\nvoid " << className << "::flushBatches() {";
+   foreach (const InterfaceMethod &method, methods) {
+      if ( !method.batch ) {
+         continue;
+      }
+      out << "\n   if ( !" << batchMember(method) << ".isEmpty() ) {\n"
+          << "      QList<" << argsStruct(className, method) << "> batch = "
+          << batchMember(method) << ";\n"
+          << "      " << batchMember(method) << ".clear();\n"
+          << "      emit " << method.name << "Batch(batch);\n"
+          << "   }";
+   }
+   out << "\n}\n";
+}
+
+/// Args structures of the batch methods. Written to the public section.
+static void writeBatchStructs(QTextStream &out, const QList<InterfaceMethod> &methods) {
+   foreach (const InterfaceMethod &method, methods) {
+      if ( !method.batch ) {
+         continue;
+      }
+      out << "\n         struct " << capitalized(method.name) << "Args {";
+      foreach (const InterfaceParam &param, method.params) {
+         out << "\n            " << param.type << " " << param.name << ";";
+      }
+      out << "\n         };\n";
+   }
+   if ( hasBatches(methods) ) {
+      out << "\n         virtual void flushBatches();\n";
+   }
+}
+
+/// Batch signals. Written to the signals section.
+static void writeBatchSignals(QTextStream &out, const QString &className,
+                              const QList<InterfaceMethod> &methods) {
+   foreach (const InterfaceMethod &method, methods) {
+      if ( method.batch ) {
+         out << "\n         void " << method.name << "Batch(const QList<"
+             << argsStruct(className, method) << "> &batch);";
+      }
+   }
+}
+
+/// Calls waiting for the batch signals. Written to the private section.
+static void writeBatchMembers(QTextStream &out, const QString &className,
+                              const QList<InterfaceMethod> &methods) {
+   foreach (const InterfaceMethod &method, methods) {
+      if ( method.batch ) {
+         out << "         QList<" << argsStruct(className, method) << "> "
+             << batchMember(method) << ";\n";
+      }
+   }
+}
+
+/**
+ * Writes structure declared in the interface together with its converters.
+ * Fields are packed into qrs::Record at positions given by their tags and
+ * lists of structures into single qrs::RecordList so binary serializers
+ * write neither field names nor a map per element. Converters accept QVariantMap as well since
+ * JSON objects are decoded to maps.
+ *
+ * Values at unknown positions written by newer interface version are
+ * ignored and absent optional fields get their default values so peers
+ * using different versions of the structure can talk to each other.
+ */
+static void writeStruct(QTextStream &out, const InterfaceStruct &record) {
+   const QString guard = "_" + record.name + "Struct_H";
+   const QString fields = "fields_" + record.name;
+   const QString reader = "readRecord";
+   // Field names in the order of record positions. Positions which are not
+   // used by any field have empty names.
+   QStringList layout;
+   QStringList initializers;
+   foreach (const InterfaceParam &field, record.fields) {
+      while ( layout.size() <= field.tag ) {
+         layout.append(QString());
+      }
+      layout[field.tag] = field.name;
+      if ( !field.defaultValue.isEmpty() ) {
+         initializers.append(field.name + "(" + field.defaultValue + ")");
+      }
+   }
+   out << "#ifndef " << guard << "\n"
+       << "#define " << guard << "\n"
+       << "\n"
+       << "struct " << record.name << " {\n";
+   if ( !initializers.isEmpty() ) {
+      out << "   " << record.name << "(): " << initializers.join(", ") << " {}\n"
+          << "\n";
+   }
+   foreach (const InterfaceParam &field, record.fields) {
+      out << "   " << field.type << " " << field.name << ";\n";
+   }
+   out << "};\n"
+       << "\n"
+       << "Q_DECLARE_METATYPE(" << record.name << ");\n"
+       << "\n"
+       << "namespace qrs {\n"
+       << "\n"
+       << "   namespace internals {\n"
+       << "      inline const QStringList *" << fields << "() {\n"
+       << "         static const QStringList fields = QStringList()";
+   foreach (const QString &name, layout) {
+      out << " << \"" << name << "\"";
+   }
+   out << ";\n"
+       << "         return &fields;\n"
+       << "      }\n"
+       << "\n"
+       << "      inline bool " << reader << "(const RecordReader &reader, "
+       << record.name << " &res) {\n"
+       << "         const QVariant *field;\n";
+   foreach (const InterfaceParam &field, record.fields) {
+      if ( field.optional ) {
+         out << "         if ( (field = reader.field(" << field.tag << ")) == 0 || "
+             << "!field->isValid() ) {\n"
+             << "            res." << field.name << " = " << defaultValue(field) << ";\n"
+             << "         } else if ( !getArgValue(*field, res." << field.name << ") ) {\n";
+      } else {
+         out << "         if ( (field = reader.field(" << field.tag << ")) == 0 || "
+             << "!getArgValue(*field, res." << field.name << ") ) {\n";
+      }
+      out << "            return false;\n"
+          << "         }\n";
+   }
+   out << "         return true;\n"
+       << "      }\n"
+       << "   }\n"
+       << "\n"
+       << "   inline QVariant createArg(const " << record.name << " &val) {\n"
+       << "      Record res(internals::" << fields << "());\n";
+   foreach (const QString &name, layout) {
+      if ( name.isEmpty() ) {
+         out << "      res.values().append(QVariant());\n";
+      } else {
+         out << "      res.values().append(createArg(val." << name << "));\n";
+      }
+   }
+   out << "      return QVariant::fromValue(res);\n"
+       << "   }\n"
+       << "\n"
+       << "   inline bool getArgValue(const QVariant &arg, " << record.name << " &res) {\n"
+       << "      return internals::" << reader << "(RecordReader(arg, *internals::"
+       << fields << "()), res);\n"
+       << "   }\n"
+       << "\n"
+       << "   inline QVariant createArg(const QList<" << record.name << "> &val) {\n"
+       << "      RecordList res(internals::" << fields << "());\n"
+       << "      for (QList<" << record.name << ">::const_iterator it = val.constBegin(); "
+       << "it != val.constEnd(); ++it) {\n";
+   foreach (const QString &name, layout) {
+      if ( name.isEmpty() ) {
+         out << "         res.cells().append(QVariant());\n";
+      } else {
+         out << "         res.cells().append(createArg(it->" << name << "));\n";
+      }
+   }
+   out << "      }\n"
+       << "      return QVariant::fromValue(res);\n"
+       << "   }\n"
+       << "\n"
+       << "   inline bool getArgValue(const QVariant &arg, QList<" << record.name << "> &res) {\n"
+       << "      res.clear();\n"
+       << "      const RecordList *list = RecordList::get(arg);\n"
+       << "      if ( list != 0 ) {\n"
+       << "         for (int row = 0; row < list->rows(); row++) {\n"
+       << "            " << record.name << " item;\n"
+       << "            if ( !internals::" << reader << "(RecordReader(*list, row), item) ) {\n"
+       << "               return false;\n"
+       << "            }\n"
+       << "            res.append(item);\n"
+       << "         }\n"
+       << "         return true;\n"
+       << "      }\n"
+       << "      if ( !arg.canConvert<QVariantList>() ) {\n"
+       << "         return false;\n"
+       << "      }\n"
+       << "      const QVariantList items = arg.toList();\n"
+       << "      for (QVariantList::const_iterator it = items.constBegin(); "
+       << "it != items.constEnd(); ++it) {\n"
+       << "         " << record.name << " item;\n"
+       << "         if ( !getArgValue(*it, item) ) {\n"
+       << "            return false;\n"
+       << "         }\n"
+       << "         res.append(item);\n"
+       << "      }\n"
+       << "      return true;\n"
+       << "   }\n"
+       << "\n"
+       << "}\n"
+       << "\n"
+       << "#endif\n"
+       << "\n";
+}
+
+/**
+ * Structures are written after custom types headers since their fields can
+ * have custom types and before template converters so lists and maps of
+ * structures can be used in the interface. Template converters are declared
+ * before the structures so their fields can be lists and maps too.
+ */
+static void writeHeaderIncludes(QTextStream &out, const InterfaceDocument *interface) {
+   out << "#include <QtCore/QObject>\n"
+       << "#include <QtCore/QString>\n";
+   if ( !interface->structs().isEmpty() ) {
+      out << "#include <QtCore/QList>\n"
+          << "#include <QtCore/QMap>\n";
+   }
+   out << "\n"
+       << "#include <baseconverters.h>\n";
+   if ( !interface->structs().isEmpty() ) {
+      out << "#include <record.h>\n";
+   }
+   foreach (const QString &header, interface->customTypesHeaders()) {
+      out << "\n#include \"" << header << "\"";
+   }
+   out << "\n\n";
+   if ( !interface->structs().isEmpty() ) {
+      out << "namespace qrs {\n"
+          << "   template<typename T> QVariant createArg(const QList<T>& val);\n"
+          << "   template<typename T> bool getArgValue(const QVariant& arg, QList<T>& res);\n"
+          << "   template<typename T> QVariant createArg(const QMap<QString,T>& val);\n"
+          << "   template<typename T> bool getArgValue(const QVariant& arg, QMap<QString,T>& res);\n"
+          << "}\n"
+          << "\n";
+   }
+   foreach (const InterfaceStruct &record, interface->structs()) {
+      writeStruct(out, record);
+   }
+   out << "#include <templateconverters.h>\n"
+       << "#include <QRemoteSignal>\n"
+       << "\n";
+}
+
+QString InterfaceCompiler::banner() const {
+   return QString(
+      "/*\n"
+      "This code was generated with the qrsc utility (QRemoteSignal interface\n"
+      "compiler) version %1 from file:\n"
+      "%2\n"
+      "\n"
+      "Do not modify this file directly. Modify interface description and\n"
+      "run qrsc once again.\n"
+      "*/\n"
+   ).arg(VERSION).arg(mInterface->sourceName());
+}
+
+QString InterfaceCompiler::serviceHeaderCode() const {
+   const QString className = mInterface->name() + "Service";
+   QString res;
+   QTextStream out(&res, QIODevice::WriteOnly);
+   out << banner()
+       << "#ifndef _" << className << "_H\n"
+       << "#define _" << className << "_H\n"
+       << "\n";
+   writeHeaderIncludes(out, mInterface);
+   out << "namespace qrs {\n"
+       << "\n"
+       << "   class " << className << " : public AbsService {\n"
+       << "      Q_OBJECT\n"
+       << "      public:\n"
+       << "         explicit " << className << " ( QObject* parent=0 ): AbsService ( parent ) {}\n"
+       << "         explicit " << className << " ( ServicesManager* parent );\n"
+       << "         virtual ~" << className << "() {}\n"
+       << "\n"
+       << "         virtual const QString& name() const {return mName;}\n"
+       << "         virtual void processMessage ( const Message& msg )\n"
+       << "               throw(IncorrectMethodException);\n"
+       << "         virtual void processMessage ( const Message& msg, Status &status );\n";
+   writeBatchStructs(out, mInterface->remoteSlots());
+   out << "\n"
+       << "      public slots:\n";
+   foreach (const InterfaceMethod &method, mInterface->remoteSignals()) {
+      out << "\n         void " << method.name << "(" << paramsDeclaration(method, true, true) << ");";
+   }
+   out << "\n\n      signals:\n";
+   foreach (const InterfaceMethod &method, mInterface->remoteSlots()) {
+      out << "\n         void " << method.name << "(" << paramsDeclaration(method, false) << ");";
+   }
+   writeBatchSignals(out, className, mInterface->remoteSlots());
+   out << "\n\n"
+       << "      private:\n"
+       << "         Q_DISABLE_COPY(" << className << ");\n"
+       << "\n"
+       << "         static const QString mName;\n";
+   writeBatchMembers(out, className, mInterface->remoteSlots());
+   out << "   };\n"
+       << "\n"
+       << "}\n"
+       << "\n"
+       << "#endif\n";
+   out.flush();
+   return res;
+}
+
+QString InterfaceCompiler::serviceSourceCode() const {
+   const QString className = mInterface->name() + "Service";
+   QString res;
+   QTextStream out(&res, QIODevice::WriteOnly);
+   out << banner()
+       << "#include \"" << QFileInfo(mInterface->serviceHeader()).fileName() << "\"\n"
+       << "\n"
+       << "#include <QRemoteSignal>\n"
+       << "\n"
+       << "using namespace qrs;\n"
+       << "\n";
+   writeNames(out, mInterface);
+   out << "const QString " << className << "::mName = \"" << mInterface->name() << "\";\n"
+       << "\n"
+       << className << "::" << className << " ( ServicesManager* parent ): AbsService ( parent ) {\n"
+       << "   parent->registerService(this);\n"
+       << "}\n"
+       << "\n";
+   foreach (const InterfaceMethod &method, mInterface->remoteSignals()) {
+      writeSender(out, className, method);
+   }
+   writeProcessMessage(out, className, mInterface->remoteSlots(), false);
+   writeFlushBatches(out, className, mInterface->remoteSlots());
+   out.flush();
+   return res;
+}
+
+QString InterfaceCompiler::clientHeaderCode() const {
+   const QString className = mInterface->name() + "Client";
+   QString res;
+   QTextStream out(&res, QIODevice::WriteOnly);
+   out << banner()
+       << "#ifndef _" << className << "_H\n"
+       << "#define _" << className << "_H\n"
+       << "\n";
+   writeHeaderIncludes(out, mInterface);
+   out << "namespace qrs {\n"
+       << "\n"
+       << "   class " << className << " : public AbsService {\n"
+       << "      Q_OBJECT\n"
+       << "      public:\n"
+       << "         explicit " << className << " ( QObject* parent=0 ): AbsService(parent) {}\n"
+       << "         explicit " << className << " ( ServicesManager* parent );\n"
+       << "         virtual ~" << className << "() {}\n"
+       << "\n"
+       << "         virtual void processMessage(const Message& msg)\n"
+       << "               throw(IncorrectMethodException);\n"
+       << "         virtual void processMessage(const Message& msg, Status &status);\n"
+       << "\n"
+       << "         virtual const QString& name() const {return mName;}\n";
+   writeBatchStructs(out, mInterface->remoteSignals());
+   foreach (const InterfaceMethod &method, mInterface->remoteSignals()) {
+      const QString signal = capitalized(method.name);
+      out << "\n         void subscribe" << signal << "();";
+      foreach (const InterfaceParam &param, method.params) {
+         out << "\n         void subscribe" << signal << "By" << capitalized(param.name)
+             << "(const " << param.type << "& " << param.name << ");";
+      }
+      out << "\n         void unsubscribe" << signal << "();";
+   }
+   out << "\n      public slots:\n";
+   foreach (const InterfaceMethod &method, mInterface->remoteSlots()) {
+      out << "\n         void " << method.name << "(" << paramsDeclaration(method, true, true) << ");";
+   }
+   out << "\n\n      signals:\n";
+   foreach (const InterfaceMethod &method, mInterface->remoteSignals()) {
+      out << "\n         void " << method.name << "(" << paramsDeclaration(method, false) << ");";
+   }
+   writeBatchSignals(out, className, mInterface->remoteSignals());
+   out << "\n\n"
+       << "      private:\n"
+       << "         Q_DISABLE_COPY(" << className << ");\n"
+       << "\n"
+       << "         static const QString mName;\n";
+   writeBatchMembers(out, className, mInterface->remoteSignals());
+   out << "   };\n"
+       << "\n"
+       << "}\n"
+       << "\n"
+       << "#endif\n";
+   out.flush();
+   return res;
+}
+
+QString InterfaceCompiler::clientSourceCode() const {
+   const QString className = mInterface->name() + "Client";
+   QString res;
+   QTextStream out(&res, QIODevice::WriteOnly);
+   out << banner()
+       << "#include \"" << QFileInfo(mInterface->clientHeader()).fileName() << "\"\n"
+       << "\n"
+       << "#include <QRemoteSignal>\n"
+       << "\n"
+       << "using namespace qrs;\n"
+       << "\n";
+   writeNames(out, mInterface);
+   out << "const QString " << className << "::mName = \"" << mInterface->name() << "\";\n"
+       << "\n"
+       << className << "::" << className << " ( ServicesManager* parent ): AbsService(parent) {\n"
+       << "   parent->registerService(this);\n"
+       << "}\n"
+       << "\n";
+   foreach (const InterfaceMethod &method, mInterface->remoteSlots()) {
+      writeSender(out, className, method);
+   }
+   foreach (const InterfaceMethod &method, mInterface->remoteSignals()) {
+      const QString signal = capitalized(method.name);
+      out << "void " << className << "::subscribe" << signal << "() {\n"
+          << "   if ( manager() == 0 ) {\n"
+          << "      return;\n"
+          << "   }\n"
+          << "   manager()->subscribe(mName, " << methodName(method.name) << ");\n"
+          << "}\n\n";
+      foreach (const InterfaceParam &param, method.params) {
+         out << "void " << className << "::subscribe" << signal << "By"
+             << capitalized(param.name) << "(const " << param.type << "& "
+             << param.name << ") {\n"
+             << "   if ( manager() == 0 ) {\n"
+             << "      return;\n"
+             << "   }\n"
+             << "   QVariantMap filter;\n"
+             << "   filter.insert(" << paramName(param.name) << ",qrs::createArg(" << param.name << "));\n"
+             << "   manager()->subscribe(mName, " << methodName(method.name) << ", filter);\n"
+             << "}\n\n";
+      }
+      out << "void " << className << "::unsubscribe" << signal << "() {\n"
+          << "   if ( manager() == 0 ) {\n"
+          << "      return;\n"
+          << "   }\n"
+          << "   manager()->unsubscribe(mName, " << methodName(method.name) << ");\n"
+          << "}\n\n";
+   }
+   writeProcessMessage(out, className, mInterface->remoteSignals(), true);
+   writeFlushBatches(out, className, mInterface->remoteSignals());
+   out.flush();
+   return res;
+}
+
+bool InterfaceCompiler::compileServiceHeader() {
+   return writeFile(mInterface->serviceHeader(), serviceHeaderCode());
+}
+
+bool InterfaceCompiler::compileServiceSource() {
+   return writeFile(mInterface->serviceSource(), serviceSourceCode());
+}
+
+bool InterfaceCompiler::compileClientHeader() {
+   return writeFile(mInterface->clientHeader(), clientHeaderCode());
 }
 
 bool InterfaceCompiler::compileClientSource() {
-   QFile xsltFile(":/ClientSource.xsl");
-   QFile out(mInterface->clientSource());
-   xsltFile.open(QIODevice::ReadOnly | QIODevice::Text);
-   out.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate);
-
-   return xsltTransformation(out,xsltFile);
-}
-
-bool InterfaceCompiler::xsltTransformation(QFile &dest, QFile &xsltFile) {
-   mInterface->getIODevice()->seek(0);
-   QXmlQuery query(QXmlQuery::XSLT20);
-   // Bind variables
-   query.bindVariable( "QRSC_VERSION",
-                       QXmlItem(QVariant(VERSION)) );
-   query.bindVariable( "SRC_INTERFACE",
-                       QXmlItem(QVariant(mInterface->sourceName())) );
-   QFileInfo serviceHeaderInfo(mInterface->serviceHeader());
-   query.bindVariable( "ServiceHeader",
-                       QXmlItem(QVariant(serviceHeaderInfo.fileName())) );
-   QFileInfo clientHeaderInfo(mInterface->clientHeader());
-   query.bindVariable( "ClientHeader",
-                       QXmlItem(QVariant(clientHeaderInfo.fileName())) );
-   // prepare query
-   query.setFocus(mInterface->getIODevice());
-   query.setQuery(&xsltFile);
-   // Transform
-   QTextSerializer serializer(query,&dest);
-   if ( !query.evaluateTo(&serializer) ) {
-      /// @todo Produce some fail information
+   return writeFile(mInterface->clientSource(), clientSourceCode());
+}
+
+bool InterfaceCompiler::writeFile(const QString &path, const QString &code) {
+   mOutputs.append(path);
+   return writeIfChanged(path, code.toUtf8());
+}
+
+/**
+ * Writes data to the file only if the file content differs. Unchanged files
+ * keep their modification time so the build system doesn't recompile
+ * translation units including them.
+ */
+bool InterfaceCompiler::writeIfChanged(const QString &path, const QByteArray &data) {
+   QFile out(path);
+   if ( out.size() == data.size() && out.open(QIODevice::ReadOnly) ) {
+      bool same = out.readAll() == data;
+      out.close();
+      if ( same ) {
+         return true;
+      }
+   }
+   if ( !out.open(QIODevice::WriteOnly | QIODevice::Truncate) ) {
       return false;
    }
-   return true;
+   return out.write(data) == data.size();
 }
@@ -8,10 +8,17 @@
 #ifndef InterfaceCompiler_H
 #define InterfaceCompiler_H
 
-#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QByteArray>
 
 #include "interfacedocument.h"
 
+/**
+ * Generates C++ code of the service and client classes from the parsed
+ * interface description. Code is generated into memory without reading the
+ * interface file once again so all outputs are produced from one parse.
+ */
 class InterfaceCompiler {
    public:
       InterfaceCompiler (InterfaceDocument* interface) {mInterface = interface;};
@@ -22,10 +29,23 @@ class InterfaceCompiler {
       bool compileClientHeader();
       bool compileClientSource();
 
+      QString serviceHeaderCode() const;
+      QString serviceSourceCode() const;
+      QString clientHeaderCode() const;
+      QString clientSourceCode() const;
+
+      /// Files generated by the compile* functions called
+      const QStringList &outputs() const {return mOutputs;}
+
+      static bool writeIfChanged(const QString &path, const QByteArray &data);
+
    protected:
-      bool xsltTransformation(QFile &source, QFile &xsltFile);
+      bool writeFile(const QString &path, const QString &code);
    private:
       InterfaceDocument *mInterface;
+      QStringList mOutputs;
+
+      QString banner() const;
 };
 
 #endif
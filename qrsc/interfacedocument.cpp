@@ -12,6 +12,7 @@
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QBuffer>
+#include <QtCore/QSet>
 #include <QtCore/QXmlStreamReader>
 #include <QtCore/QDebug>
 
@@ -19,10 +20,78 @@
 #include <QtXmlPatterns/QXmlFormatter>
 
 const QString SERVICE_ELEMENT_NAME = "service";
+const QString SLOT_ELEMENT_NAME = "slot";
+const QString SIGNAL_ELEMENT_NAME = "signal";
+const QString PARAM_ELEMENT_NAME = "param";
+const QString STRUCT_ELEMENT_NAME = "struct";
+const QString FIELD_ELEMENT_NAME = "field";
+const QString CUSTOM_TYPES_ELEMENT_NAME = "customTypes";
 const QString NAME_ATTRIBUTE = "name";
+const QString TYPE_ATTRIBUTE = "type";
+const QString HEADER_ATTRIBUTE = "header";
+const QString DEFAULT_ATTRIBUTE = "default";
+const QString OPTIONAL_ATTRIBUTE = "optional";
+const QString TAG_ATTRIBUTE = "tag";
+const QString BATCH_ATTRIBUTE = "batch";
+const int MAX_FIELD_TAG = 255;
 
 const QString DEPRICATED_METHOD_TAG = "method";
 
+/// Reads slot or signal element attributes
+static InterfaceMethod readMethod(const QXmlStreamAttributes &attributes) {
+   InterfaceMethod res;
+   res.name = attributes.value(NAME_ATTRIBUTE).toString();
+   QString batch = attributes.value(BATCH_ATTRIBUTE).toString();
+   res.batch = batch == "true" || batch == "1";
+   return res;
+}
+
+/// Reads param or field element attributes
+static InterfaceParam readParam(const QXmlStreamAttributes &attributes) {
+   InterfaceParam res;
+   res.type = attributes.value(TYPE_ATTRIBUTE).toString();
+   res.name = attributes.value(NAME_ATTRIBUTE).toString();
+   res.defaultValue = attributes.value(DEFAULT_ATTRIBUTE).toString();
+   QString optional = attributes.value(OPTIONAL_ATTRIBUTE).toString();
+   res.optional = !res.defaultValue.isEmpty() ||
+                  optional == "true" || optional == "1";
+   if ( attributes.hasAttribute(TAG_ATTRIBUTE) ) {
+      bool ok = false;
+      res.tag = attributes.value(TAG_ATTRIBUTE).toString().toInt(&ok);
+      // Unused positions are written as invalid values so tags are kept small
+      if ( !ok || res.tag < 0 || res.tag > MAX_FIELD_TAG ) {
+         res.tag = -2;
+      }
+   }
+   return res;
+}
+
+/**
+ * Assigns record positions to the fields without explicit tag. Such field
+ * takes position following the previous field.
+ *
+ * @return false if tags are invalid or two fields have the same position
+ */
+static bool assignTags(InterfaceStruct &record) {
+   QSet<int> used;
+   int next = 0;
+   for (int i = 0; i < record.fields.size(); i++) {
+      InterfaceParam &field = record.fields[i];
+      if ( field.tag == -2 ) {
+         return false;
+      }
+      if ( field.tag == -1 ) {
+         field.tag = next;
+      }
+      if ( used.contains(field.tag) ) {
+         return false;
+      }
+      used.insert(field.tag);
+      next = field.tag + 1;
+   }
+   return true;
+}
+
 InterfaceDocument::InterfaceDocument(const QString& path) {
    // Initializing members
    mInterfaceFile = new QFile(path);
@@ -31,8 +100,11 @@ InterfaceDocument::InterfaceDocument(const QString& path) {
    mInterfaceFile->open(QIODevice::ReadOnly | QIODevice::Text);
    QFileInfo sourceInfo(path);
    mSourceName = sourceInfo.fileName();
-   // Searching through the document for name and checking its consistency
+   // Reading the whole document once. Code generators use the parsed
+   // description and never read the file again.
    bool outdated = false;
+   InterfaceMethod *current = 0;
+   InterfaceStruct *currentStruct = 0;
    QXmlStreamReader xml(mInterfaceFile);
    while ( !xml.atEnd() ) {
       if ( xml.readNext() == QXmlStreamReader::StartElement ) {
@@ -41,8 +113,41 @@ InterfaceDocument::InterfaceDocument(const QString& path) {
             mName.append(xml.attributes().value(NAME_ATTRIBUTE));
             continue;
          }
-         if ( xml.name().compare(DEPRICATED_METHOD_TAG,Qt::CaseInsensitive) == 0 ) {
-            outdated = true;
+         if ( xml.name().compare(CUSTOM_TYPES_ELEMENT_NAME,Qt::CaseInsensitive) == 0 ) {
+            mCustomTypesHeaders.append(xml.attributes().value(HEADER_ATTRIBUTE).toString());
+            continue;
+         }
+         // Deprecated method element has the same meaning as slot
+         bool isMethod = xml.name().compare(DEPRICATED_METHOD_TAG,Qt::CaseInsensitive) == 0;
+         if ( isMethod ||
+              xml.name().compare(SLOT_ELEMENT_NAME,Qt::CaseInsensitive) == 0 ) {
+            outdated = outdated || isMethod;
+            mSlots.append(readMethod(xml.attributes()));
+            current = &mSlots.last();
+            currentStruct = 0;
+            continue;
+         }
+         if ( xml.name().compare(SIGNAL_ELEMENT_NAME,Qt::CaseInsensitive) == 0 ) {
+            mSignals.append(readMethod(xml.attributes()));
+            current = &mSignals.last();
+            currentStruct = 0;
+            continue;
+         }
+         if ( xml.name().compare(STRUCT_ELEMENT_NAME,Qt::CaseInsensitive) == 0 ) {
+            mStructs.append(InterfaceStruct());
+            currentStruct = &mStructs.last();
+            currentStruct->name = xml.attributes().value(NAME_ATTRIBUTE).toString();
+            current = 0;
+            continue;
+         }
+         if ( xml.name().compare(FIELD_ELEMENT_NAME,Qt::CaseInsensitive) == 0 &&
+              currentStruct != 0 ) {
+            currentStruct->fields.append(readParam(xml.attributes()));
+            continue;
+         }
+         if ( xml.name().compare(PARAM_ELEMENT_NAME,Qt::CaseInsensitive) == 0 &&
+              current != 0 ) {
+            current->params.append(readParam(xml.attributes()));
             continue;
          }
       }
@@ -58,6 +163,13 @@ InterfaceDocument::InterfaceDocument(const QString& path) {
       mError = tr("Interface name not found");
       return;
    }
+   for (int i = 0; i < mStructs.size(); i++) {
+      if ( !assignTags(mStructs[i]) ) {
+         mValid = false;
+         mError = tr("Invalid or duplicate field tags in struct %1").arg(mStructs[i].name);
+         return;
+      }
+   }
    // Updating document if necessary
    if ( outdated ) {
       qWarning() << mSourceName << tr("<method> element is deprecated use <slot> instead");
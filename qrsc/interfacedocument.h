@@ -9,9 +9,47 @@
 #define InterfaceDocument_H
 
 #include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QList>
 #include <QtCore/QIODevice>
 #include <QtCore/QObject>
 
+/**
+ * Param of a remote slot or signal or a structure field description
+ */
+struct InterfaceParam {
+   InterfaceParam(): optional(false), tag(-1) {}
+
+   QString type;
+   QString name;
+   /// C++ expression used if the value is absent in the message
+   QString defaultValue;
+   /// Value can be absent in the message
+   bool optional;
+   /// Position of the structure field in the binary record
+   int tag;
+};
+
+/**
+ * Remote slot or signal description
+ */
+struct InterfaceMethod {
+   InterfaceMethod(): batch(false) {}
+
+   QString name;
+   QList<InterfaceParam> params;
+   /// Calls received at once are also delivered with one batch signal
+   bool batch;
+};
+
+/**
+ * Structure declared in the interface description
+ */
+struct InterfaceStruct {
+   QString name;
+   QList<InterfaceParam> fields;
+};
+
 class InterfaceDocument: public QObject {
    Q_OBJECT
    public:
@@ -34,6 +72,15 @@ class InterfaceDocument: public QObject {
       const QString &clientSource() const {return mClientSource;}
       void setClientSource(const QString& val) {mClientSource = val;}
 
+      /// Slots of the service in the order of the interface description
+      const QList<InterfaceMethod> &remoteSlots() const {return mSlots;}
+      /// Signals of the service in the order of the interface description
+      const QList<InterfaceMethod> &remoteSignals() const {return mSignals;}
+      /// Structures in the order of the interface description
+      const QList<InterfaceStruct> &structs() const {return mStructs;}
+      /// Headers with custom types converters
+      const QStringList &customTypesHeaders() const {return mCustomTypesHeaders;}
+
       bool isValid() const {return mValid;}
       const QString &error() const {return mError;}
 
@@ -47,6 +94,10 @@ class InterfaceDocument: public QObject {
       QString mName;
       QString mServiceHeader,mServiceSource;
       QString mClientHeader,mClientSource;
+      QList<InterfaceMethod> mSlots;
+      QList<InterfaceMethod> mSignals;
+      QList<InterfaceStruct> mStructs;
+      QStringList mCustomTypesHeaders;
       bool mValid;
       QString mError;
 };
@@ -13,6 +13,10 @@
 #include <QtCore/QString>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QTranslator>
+#include <QtCore/QDir>
+#include <QtCore/QList>
+#include <QtCore/QThreadPool>
+#include <QtCore/QtConcurrentMap>
 
 #include "interfacedocument.h"
 #include "interfacecompiler.h"
@@ -25,6 +29,130 @@ const QString cleint = "client";
 const QString header = "header";
 const QString source = "source";
 const QString update = "update";
+const QString outputDir = "output-dir";
+const QString jobs = "jobs";
+const QString depfile = "depfile";
+const QString stamp = "stamp";
+}
+
+/**
+ * Compilation of one interface file. Jobs are independent so they are run
+ * in parallel.
+ */
+struct CompileJob {
+    QString interface;
+    QString outputDir;
+    bool service;
+    bool client;
+    /// Explicitly specified outputs. Allowed for single interface only.
+    QString header;
+    QString source;
+    /// Files generated
+    QStringList outputs;
+    /// Empty on success
+    QString error;
+};
+
+/// Escapes file name for the Makefile syntax used by the depfiles
+static QString depfileEscape(const QString &path)
+{
+    QString res = QDir::fromNativeSeparators(path);
+    res.replace(" ", "\\ ");
+    res.replace("#", "\\#");
+    return res;
+}
+
+/**
+ * Writes Makefile style dependencies understood by make, ninja and CMake
+ * DEPFILE option. Generated code depends on the interface and on the qrsc
+ * binary itself which embeds the code templates and the schema updates.
+ * If @a stamp is given it is the only target since generated files which
+ * are not changed keep their old modification time. Otherwise there is one
+ * rule per compiled interface.
+ */
+static bool writeDepfile(const QString &path, const QString &stamp,
+                         const QList<CompileJob> &jobs)
+{
+    const QString qrsc = depfileEscape(QCoreApplication::applicationFilePath());
+    QString content;
+    if (!stamp.isEmpty()) {
+        QStringList inputs;
+        foreach (const CompileJob &job, jobs)
+            inputs.append(depfileEscape(job.interface));
+        content = QString("%1: %2 %3\n")
+            .arg(depfileEscape(stamp))
+            .arg(inputs.join(" "))
+            .arg(qrsc);
+    } else {
+        foreach (const CompileJob &job, jobs) {
+            QStringList targets;
+            foreach (const QString &output, job.outputs)
+                targets.append(depfileEscape(output));
+            content += QString("%1: %2 %3\n")
+                .arg(targets.join(" "))
+                .arg(depfileEscape(job.interface))
+                .arg(qrsc);
+        }
+    }
+    return InterfaceCompiler::writeIfChanged(path, content.toUtf8());
+}
+
+/**
+ * Stamp is rewritten on every successful run unlike the generated files so
+ * the build system knows the generation is done even if nothing changed.
+ */
+static bool writeStamp(const QString &path, const QList<CompileJob> &jobs)
+{
+    QStringList outputs;
+    foreach (const CompileJob &job, jobs)
+        outputs += job.outputs;
+    const QByteArray content = (outputs.join("\n") + "\n").toUtf8();
+    QFile out(path);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return out.write(content) == content.size();
+}
+
+static void compile(CompileJob &job)
+{
+    InterfaceDocument inputDoc(job.interface);
+    if (!inputDoc.isValid()) {
+        job.error = QString("%1: %2").arg(job.interface).arg(inputDoc.error());
+        return;
+    }
+    QDir outDir(job.outputDir);
+    inputDoc.setServiceHeader(outDir.filePath(inputDoc.serviceHeader()));
+    inputDoc.setServiceSource(outDir.filePath(inputDoc.serviceSource()));
+    inputDoc.setClientHeader(outDir.filePath(inputDoc.clientHeader()));
+    inputDoc.setClientSource(outDir.filePath(inputDoc.clientSource()));
+    if (job.service) {
+        if (!job.header.isEmpty())
+            inputDoc.setServiceHeader(job.header);
+        if (!job.source.isEmpty())
+            inputDoc.setServiceSource(job.source);
+    } else {
+        if (!job.header.isEmpty())
+            inputDoc.setClientHeader(job.header);
+        if (!job.source.isEmpty())
+            inputDoc.setClientSource(job.source);
+    }
+    // Interface file is parsed once and all the outputs are generated from
+    // the parsed description.
+    InterfaceCompiler compiler(&inputDoc);
+    bool ok = true;
+    if (job.service) {
+        ok = ok && compiler.compileServiceHeader();
+        ok = ok && compiler.compileServiceSource();
+    }
+    if (job.client) {
+        ok = ok && compiler.compileClientHeader();
+        ok = ok && compiler.compileClientSource();
+    }
+    job.outputs = compiler.outputs();
+    if (!ok) {
+        job.error = QString("%1: %2").arg(job.interface)
+            .arg(QCoreApplication::tr("Failed to compile the interface!"));
+    }
 }
 
 ArgvConf qrscArgConf = {
@@ -32,9 +160,11 @@ ArgvConf qrscArgConf = {
     VERSION,
     QT_TRANSLATE_NOOP(
         "ArgvParser",
-        "QRemoteSignal interface compiler. Creates client or service source "
-        "files from interface XML description. Only one of the --service or "
-        "--client flags should be specified but not both."
+        "QRemoteSignal interface compiler. Creates client and/or service "
+        "source files from interface XML descriptions. Several interfaces "
+        "can be compiled at once in parallel. Options --header and --source "
+        "can be used only if single interface is compiled and only one of "
+        "the --service or --client flags is specified."
     )
 };
 
@@ -58,6 +188,10 @@ int main(int argc, char *argv[])
         .arg(cmd::service)
         .arg(cmd::cleint)
     );
+    conf.addUsageDescription(ArgvParser::tr("[--%1] [--%2] [OPTIONS] INTERFACE...")
+        .arg(cmd::service)
+        .arg(cmd::cleint)
+    );
     conf.addUsageDescription(ArgvParser::tr("--%1 SOURCE DEST")
         .arg(cmd::update)
     );
@@ -84,6 +218,33 @@ int main(int argc, char *argv[])
         ArgvParser::tr("DEST_CPP"),
         ArgvParser::tr("Specify output C++ source file.")
     );
+    conf.addOption(
+        cmd::outputDir,
+        ArgvParser::tr("DIR"),
+        ArgvParser::tr("Directory to put generated files with default names to."),
+        QChar(),
+        "."
+    );
+    conf.addOption(
+        cmd::jobs,
+        ArgvParser::tr("N"),
+        ArgvParser::tr("Number of interfaces compiled simultaneously. "
+                       "Number of CPU cores is used by default."),
+        cmd::jobs[0]
+    );
+    conf.addOption(
+        cmd::depfile,
+        ArgvParser::tr("DEPFILE"),
+        ArgvParser::tr("Write Makefile style dependencies of the generated "
+                       "files to DEPFILE.")
+    );
+    conf.addOption(
+        cmd::stamp,
+        ArgvParser::tr("STAMP"),
+        ArgvParser::tr("Rewrite STAMP file after successful compilation "
+                       "even if generated files are not changed. STAMP "
+                       "is the target of the DEPFILE rule.")
+    );
     if (!conf.parse())
         return 1;
     // Print info if requested
@@ -109,56 +270,59 @@ int main(int argc, char *argv[])
         return 0;
     }
 
-    InterfaceDocument inputDoc(conf.arguments().first());
-    if (!inputDoc.isValid()) {
-        err << inputDoc.error() << endl;
-        return 1;
-    }
-    // Compile document
-    InterfaceCompiler compiler(&inputDoc);
-
-    /// @todo move output files to the compiler class.
     QString header = conf.options()[cmd::header];
     QString source = conf.options()[cmd::source];
-    if (conf.flags()[cmd::service] && conf.flags()[cmd::cleint]) {
-        err << ArgvParser::tr("You should specify --%1 or --%2 flag but not both!")
-            .arg(cmd::service).arg(cmd::cleint) << endl;
-        return 1;
-    }
-    if (conf.flags()[cmd::service]) {
-        if (!header.isEmpty())
-            inputDoc.setServiceHeader(header);
-        if (!source.isEmpty())
-            inputDoc.setServiceSource(source);
-        if (!compiler.compileServiceHeader()) {
-            err << QCoreApplication::tr("Failed to compile the interface!") << endl;
-            return 1;
-        }
-        if (!compiler.compileServiceSource()) {
-            err << QCoreApplication::tr("Failed to compile the interface!") << endl;
-            return 1;
-        }
-    } else if (conf.flags()[cmd::cleint]) {
-        if (!header.isEmpty()) {
-            inputDoc.setClientHeader(header);
-        }
-        if (!source.isEmpty()) {
-            inputDoc.setClientSource(source);
-        }
-        if (!compiler.compileClientHeader()) {
-            err << QCoreApplication::tr("Failed to compile the interface!") << endl;
-            return 1;
-        }
-        if (!compiler.compileClientSource()) {
-            err << QCoreApplication::tr("Failed to compile the interface!") << endl;
-            return 1;
-        }
-    } else {
+    bool service = conf.flags()[cmd::service];
+    bool client = conf.flags()[cmd::cleint];
+    if (!service && !client) {
         err << QCoreApplication::tr("You should specify --%1 or --%2 flag!")
             .arg(cmd::service)
             .arg(cmd::cleint) << endl;
         return 1;
     }
+    if ((!header.isEmpty() || !source.isEmpty()) &&
+        ((service && client) || conf.arguments().size() > 1)) {
+        err << ArgvParser::tr("Options --%1 and --%2 can be used only with "
+                              "single interface and one of --%3 or --%4 flags!")
+            .arg(cmd::header).arg(cmd::source)
+            .arg(cmd::service).arg(cmd::cleint) << endl;
+        return 1;
+    }
+    bool jobsOk = true;
+    int jobs = conf.options()[cmd::jobs].toInt(&jobsOk);
+    if (jobsOk && jobs > 0)
+        QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+
+    QList<CompileJob> compileJobs;
+    foreach (const QString &interface, conf.arguments()) {
+        CompileJob job;
+        job.interface = interface;
+        job.outputDir = conf.options()[cmd::outputDir];
+        job.service = service;
+        job.client = client;
+        job.header = header;
+        job.source = source;
+        compileJobs.append(job);
+    }
+    QtConcurrent::blockingMap(compileJobs, compile);
 
-    return 0;
+    int res = 0;
+    foreach (const CompileJob &job, compileJobs) {
+        if (!job.error.isEmpty()) {
+            err << job.error << endl;
+            res = 1;
+        }
+    }
+    QString depfile = conf.options()[cmd::depfile];
+    QString stamp = conf.options()[cmd::stamp];
+    if (res == 0 && !depfile.isEmpty() &&
+        !writeDepfile(depfile, stamp, compileJobs)) {
+        err << ArgvParser::tr("Failed to write %1").arg(depfile) << endl;
+        res = 1;
+    }
+    if (res == 0 && !stamp.isEmpty() && !writeStamp(stamp, compileJobs)) {
+        err << ArgvParser::tr("Failed to write %1").arg(stamp) << endl;
+        res = 1;
+    }
+    return res;
 }
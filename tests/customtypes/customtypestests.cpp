@@ -39,6 +39,23 @@ class CustomTypesTests: public QObject {
       void receiveListStructList(const QList<ListStruct> &val) {
           mLastListStructReceivedList = val;
       }
+
+      void receivePoints(const QList<Point> &val) {
+         mLastPoints = val;
+      }
+
+      void receiveSegment(const Segment &val) {
+         mLastSegment = val;
+      }
+
+      void receivePath(const Path &val) {
+         mLastPath = val;
+      }
+
+      void receiveSettings(const Settings &val, bool force) {
+         mLastSettings = val;
+         mLastForce = force;
+      }
    private slots:
       /// Prepare test environment
       void initTestCase() {
@@ -56,6 +73,17 @@ class CustomTypesTests: public QObject {
          qRegisterMetaType< QMap<QString,CustomStruct> >("QMap<QString,CustomStruct>");
          qRegisterMetaType<ListStruct>("ListStruct");
          qRegisterMetaType< QList<ListStruct> >("QList<ListStruct>");
+         qRegisterMetaType< QList<Point> >("QList<Point>");
+         qRegisterMetaType<Segment>("Segment");
+         qRegisterMetaType<Path>("Path");
+         connect(mService,SIGNAL(sendPoints(QList<Point>)),
+                 this,SLOT(receivePoints(QList<Point>)));
+         connect(mService,SIGNAL(sendSegment(Segment)),
+                 this,SLOT(receiveSegment(Segment)));
+         connect(mService,SIGNAL(configure(Settings,bool)),
+                 this,SLOT(receiveSettings(Settings,bool)));
+         connect(mService,SIGNAL(sendPath(Path)),
+                 this,SLOT(receivePath(Path)));
       }
       /// Cleanup test environment
       void cleanupTestCase() {
@@ -187,6 +215,128 @@ class CustomTypesTests: public QObject {
           }
       }
 
+      void structsEncodingTest() {
+         Point point;
+         point.x = 1;
+         point.y = -2;
+         point.label = "a";
+         QVariant arg = qrs::createArg(point);
+         QVERIFY(qrs::Record::get(arg) != 0);
+         QCOMPARE(qrs::Record::get(arg)->values().size(), 3);
+
+         QList<Point> points;
+         points << point << point;
+         arg = qrs::createArg(points);
+         QVERIFY(qrs::RecordList::get(arg) != 0);
+         QCOMPARE(qrs::RecordList::get(arg)->rows(), 2);
+         QCOMPARE(qrs::RecordList::get(arg)->columns(), 3);
+
+         // Binary message doesn't contain field names
+         qrs::Message msg;
+         msg.setService("CustomType");
+         msg.setMethod("sendPoints");
+         msg.params().insert("arg", arg);
+         QByteArray data = qDataStreamSerializer_4_5->serialize(msg);
+         QVERIFY(!data.contains("label"));
+         // JSON message contains objects
+         data = jsonSerializer->serialize(msg);
+         QVERIFY(data.contains("label"));
+      }
+
+      void sendStructsTest_data() {
+         QTest::addColumn<bool>("json");
+
+         QTest::newRow("qdatastream") << false;
+         QTest::newRow("json") << true;
+      }
+      void sendStructsTest() {
+         QFETCH(bool, json);
+         if ( json ) {
+            mServerManager->setSerializer(jsonSerializer);
+            mClientManager->setSerializer(jsonSerializer);
+         } else {
+            mServerManager->setSerializer(qDataStreamSerializer_4_5);
+            mClientManager->setSerializer(qDataStreamSerializer_4_5);
+         }
+
+         QList<Point> points;
+         for (int i = 0; i < 3; i++) {
+            Point point;
+            point.x = i;
+            point.y = -i;
+            point.label = QString::number(i);
+            points.append(point);
+         }
+         mLastPoints.clear();
+         mClient->sendPoints(points);
+         QCOMPARE(mLastPoints.size(), points.size());
+         for (int i = 0; i < points.size(); i++) {
+            QCOMPARE(mLastPoints[i].x, points[i].x);
+            QCOMPARE(mLastPoints[i].y, points[i].y);
+            QCOMPARE(mLastPoints[i].label, points[i].label);
+         }
+
+         Segment segment;
+         segment.from = points[1];
+         segment.to = points[2];
+         mLastSegment = Segment();
+         mClient->sendSegment(segment);
+         QCOMPARE(mLastSegment.from.x, segment.from.x);
+         QCOMPARE(mLastSegment.from.label, segment.from.label);
+         QCOMPARE(mLastSegment.to.y, segment.to.y);
+         QCOMPARE(mLastSegment.to.label, segment.to.label);
+
+         mServerManager->setSerializer(qDataStreamSerializer_4_5);
+         mClientManager->setSerializer(qDataStreamSerializer_4_5);
+      }
+
+      void structListFieldTest() {
+         Path path;
+         path.name = "path";
+         path.steps << 3 << 1 << 2;
+         mLastPath = Path();
+         mClient->sendPath(path);
+         QCOMPARE(mLastPath.name, path.name);
+         QCOMPARE(mLastPath.steps, path.steps);
+      }
+
+      void versionsCompatibilityTest() {
+         QList<qrs::Record> versions;
+         // Older version without level field
+         qrs::Record old;
+         old.values() << QVariant("old");
+         versions << old;
+         // Newer version with one more field at unknown position
+         qrs::Record newer;
+         newer.values() << QVariant("newer") << QVariant() << QVariant(7) << QVariant(1.5);
+         versions << newer;
+         // Version with a hole at the optional level field
+         qrs::Record hole;
+         hole.values() << QVariant("hole") << QVariant() << QVariant() << QVariant(1.5);
+         versions << hole;
+
+         foreach (const qrs::Record &version, versions) {
+            qrs::Message msg;
+            msg.setService("CustomType");
+            msg.setMethod("configure");
+            msg.params().insert("settings", QVariant::fromValue(version));
+            msg.params().insert("unknown", QVariant(42));
+            mLastSettings = Settings();
+            mLastForce = false;
+            mServerManager->receive(qDataStreamSerializer_4_5->serialize(msg));
+            QCOMPARE(mLastSettings.name, version.values().first().toString());
+            QCOMPARE(mLastSettings.level,
+                     version.values().value(2).isValid() ? 7 : 5);
+            QVERIFY(mLastForce);
+         }
+
+         // Unused position between fields isn't filled
+         Settings settings;
+         QCOMPARE(settings.level, 5);
+         QCOMPARE(qrs::Record::get(qrs::createArg(settings))->values().size(), 3);
+         QVERIFY(!qrs::Record::get(qrs::createArg(settings))->values().at(1).isValid());
+      }
+
    private:
       qrs::ServicesManager *mServerManager,*mClientManager;
       qrs::CustomTypeService *mService;
@@ -197,6 +347,11 @@ class CustomTypesTests: public QObject {
       QMap<QString,CustomStruct> mLastReceivedMap;
       ListStruct mLastListStructReceived;
       QList<ListStruct> mLastListStructReceivedList;
+      QList<Point> mLastPoints;
+      Segment mLastSegment;
+      Settings mLastSettings;
+      Path mLastPath;
+      bool mLastForce;
 };
 
 #include "customtypestests.moc"
@@ -8,12 +8,16 @@
 #include <QtCore/QObject>
 #include <QtCore/QBuffer>
 #include <QtCore/QByteArray>
+#include <QtCore/QThread>
 #include <QtTest/QtTest>
+#include <QtNetwork/QUdpSocket>
 
 #include <QtCore/QtDebug>
 
 #include "QRemoteSignal"
 #include "devicemanager.h"
+#include "bufferpool.h"
+#include "keepalivewheel.h"
 
 class DeviceManagerTests: public QObject
 {
@@ -33,12 +37,32 @@ private slots:
     void testSetDevice();
     void testMesageTooBig();
     void testOnlyMessageSizeReceived();
+    void testControlFrameSkipped();
+    void testControlFramePayload();
+    void testPingPong();
+    void testPeerTimeout();
+    void testKeepAliveMoveToThread();
+    void testRateLimitDrop();
+    void testRateLimitPause();
+    void testReadBudget();
+    void testReadBudgetRoundRobin();
+    void testDatagram();
+    void testBufferPool();
+    void testFrameBufferReuse();
+    void testChannels();
+
+public slots:
+    void recordOrder(const QByteArray &msg) {mOrder.append(QString(msg));}
+    void recordChannel(const QByteArray &msg) {
+        mOrder.append(QString("%1:%2").arg(mDevManager2.receiveChannel()).arg(QString(msg)));
+    }
 
 private:
     QBuffer mDevice1;
     QBuffer mDevice2;
     qrs::internals::DeviceManager mDevManager1;
     qrs::internals::DeviceManager mDevManager2;
+    QStringList mOrder;
 
     void sendDataToDev2(const QByteArray& data) {
         qint64 pos = mDevice2.pos();
@@ -47,11 +71,23 @@ private:
         // Return to qt event loop to allow it process asincronious signals
         QTest::qWait(1);
     }
+
+    /**
+     * Same as sendDataToDev2 but delivers only the readyRead signal queued
+     * by QBuffer so timers, including the keep-alive wheel one, don't run.
+     */
+    void feedDev2(const QByteArray& data) {
+        qint64 pos = mDevice2.pos();
+        mDevice2.write(data);
+        mDevice2.seek(pos);
+        QCoreApplication::sendPostedEvents(&mDevice2, QEvent::MetaCall);
+    }
 };
 
 void DeviceManagerTests::initTestCase()
 {
     qRegisterMetaType<qrs::internals::DeviceManager *>("DeviceManager *");
+    qRegisterMetaType<qrs::internals::DeviceManager *>("qrs::internals::DeviceManager*");
 }
 
 void DeviceManagerTests::init()
@@ -68,6 +104,10 @@ void DeviceManagerTests::cleanup()
 {
     mDevice1.close();
     mDevice2.close();
+    mDevManager1.setKeepAlive(0, 0);
+    mDevManager2.setKeepAlive(0, 0);
+    mDevManager2.setRateLimit(0, 0, false);
+    mDevManager2.setReadBudget(0, 0);
 }
 
 void DeviceManagerTests::testReadingAlreadyExistingData()
@@ -267,5 +307,304 @@ void DeviceManagerTests::testOnlyMessageSizeReceived()
     QCOMPARE(spy.first().at(0).toByteArray(), msg);
 }
 
+void DeviceManagerTests::testControlFrameSkipped()
+{
+    QByteArray msg("Hello");
+    QSignalSpy spy(&mDevManager2, SIGNAL(received(QByteArray)));
+
+    mDevManager1.sendControlFrame(qrs::internals::DeviceManager::PongFrame);
+    mDevManager1.send(msg);
+    sendDataToDev2(mDevice1.buffer());
+
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(0).toByteArray(), msg);
+}
+
+void DeviceManagerTests::testControlFramePayload()
+{
+    QByteArray msg("Hello");
+    QByteArray payload("offer:json");
+    QSignalSpy spy(&mDevManager2, SIGNAL(received(QByteArray)));
+    QSignalSpy controlSpy(&mDevManager2,
+        SIGNAL(controlFrameReceived(qrs::internals::DeviceManager *, quint32, QByteArray)));
+
+    mDevManager1.sendControlFrame(qrs::internals::DeviceManager::HelloFrame,
+                                  payload);
+    mDevManager1.send(msg);
+    sendDataToDev2(mDevice1.buffer());
+
+    QCOMPARE(controlSpy.count(), 1);
+    QCOMPARE(controlSpy.first().at(1).toUInt(),
+             quint32(qrs::internals::DeviceManager::HelloFrame));
+    QCOMPARE(controlSpy.first().at(2).toByteArray(), payload);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(0).toByteArray(), msg);
+}
+
+void DeviceManagerTests::testPingPong()
+{
+    QSignalSpy spy(&mDevManager2, SIGNAL(received(QByteArray)));
+    qrs::internals::KeepAliveWheel *wheel = qrs::internals::KeepAliveWheel::instance();
+    mDevManager1.setKeepAlive(qrs::internals::KeepAliveWheel::TICK_INTERVAL, 0);
+
+    // Nothing is sent by manager 1 so it should send ping on the next tick
+    QVERIFY(mDevice1.buffer().isEmpty());
+    wheel->tick();
+    QVERIFY(!mDevice1.buffer().isEmpty());
+
+    // Manager 2 should answer with pong and ping is not a message
+    feedDev2(mDevice1.buffer());
+    QCOMPARE(spy.count(), 0);
+    QByteArray pong;
+    QDataStream stream(&pong, QIODevice::WriteOnly);
+    stream << quint32(qrs::internals::DeviceManager::PongFrame);
+    QVERIFY(mDevice2.buffer().endsWith(pong));
+}
+
+void DeviceManagerTests::testPeerTimeout()
+{
+    QSignalSpy spy(&mDevManager2, SIGNAL(peerTimeout(qrs::internals::DeviceManager *)));
+    qrs::internals::KeepAliveWheel *wheel = qrs::internals::KeepAliveWheel::instance();
+    mDevManager2.setKeepAlive(0, 3*qrs::internals::KeepAliveWheel::TICK_INTERVAL);
+
+    // Data received from the peer delays timeout
+    wheel->tick();
+    wheel->tick();
+    mDevManager1.send("Hi");
+    feedDev2(mDevice1.buffer());
+    wheel->tick();
+    wheel->tick();
+    QCOMPARE(spy.count(), 0);
+
+    wheel->tick();
+    QCOMPARE(spy.count(), 1);
+}
+
+void DeviceManagerTests::testKeepAliveMoveToThread()
+{
+    QBuffer dev;
+    dev.open(QIODevice::ReadWrite);
+    qrs::internals::DeviceManager *devManager =
+        new qrs::internals::DeviceManager(&dev, 0);
+    devManager->setKeepAlive(qrs::internals::KeepAliveWheel::TICK_INTERVAL, 0);
+
+    // Manager leaves the wheel of this thread so it is never woken up here
+    QThread thread;
+    devManager->moveToThread(&thread);
+    qrs::internals::KeepAliveWheel::instance()->tick();
+    QVERIFY(dev.buffer().isEmpty());
+
+    // Thread was never started so the manager can be deleted here
+    delete devManager;
+}
+
+void DeviceManagerTests::testRateLimitDrop()
+{
+    QSignalSpy spy(&mDevManager2, SIGNAL(received(QByteArray)));
+    QSignalSpy limitSpy(&mDevManager2,
+        SIGNAL(rateLimitExceeded(qrs::internals::DeviceManager *)));
+    mDevManager2.setRateLimit(10, 2, false);
+
+    for (int i = 0; i < 5; i++) {
+        mDevManager1.send("Hi");
+    }
+    sendDataToDev2(mDevice1.buffer());
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(limitSpy.count(), 3);
+    QVERIFY(!mDevManager2.isReadingPaused());
+
+    // Bucket is refilled with one token in 100ms
+    QTest::qWait(150);
+    int sent = mDevice1.buffer().size();
+    mDevManager1.send("Hi");
+    sendDataToDev2(mDevice1.buffer().mid(sent));
+    QCOMPARE(spy.count(), 3);
+}
+
+void DeviceManagerTests::testRateLimitPause()
+{
+    QSignalSpy spy(&mDevManager2, SIGNAL(received(QByteArray)));
+    mDevManager2.setRateLimit(20, 1, true);
+
+    for (int i = 0; i < 3; i++) {
+        mDevManager1.send("Hi");
+    }
+    sendDataToDev2(mDevice1.buffer());
+    // Message over the limit is delivered but the rest waits in the device
+    QCOMPARE(spy.count(), 2);
+    QVERIFY(mDevManager2.isReadingPaused());
+    QVERIFY(mDevice2.bytesAvailable() > 0);
+
+    QTest::qWait(300);
+    QCOMPARE(spy.count(), 3);
+}
+
+void DeviceManagerTests::testReadBudget()
+{
+    QSignalSpy spy(&mDevManager2, SIGNAL(received(QByteArray)));
+    mDevManager2.setReadBudget(2, 0);
+    mDevManager2.setDevice(0);
+
+    for (int i = 0; i < 5; i++) {
+        mDevManager1.send("Hi");
+    }
+    mDevice2.write(mDevice1.buffer());
+    mDevice2.seek(0);
+    // Only the budget is read at once the rest is read on the next turns
+    mDevManager2.setDevice(&mDevice2);
+    QCOMPARE(spy.count(), 2);
+
+    QTest::qWait(50);
+    QCOMPARE(spy.count(), 5);
+}
+
+void DeviceManagerTests::testReadBudgetRoundRobin()
+{
+    QByteArray data2, data3;
+    {
+        // QByteArray serialization is the same as message frame
+        QDataStream stream2(&data2, QIODevice::WriteOnly);
+        QDataStream stream3(&data3, QIODevice::WriteOnly);
+        for (int i = 0; i < 3; i++) {
+            stream2 << QByteArray("a");
+            stream3 << QByteArray("b");
+        }
+    }
+    QBuffer dev3;
+    dev3.setData(data3);
+    dev3.open(QIODevice::ReadWrite);
+    qrs::internals::DeviceManager devManager3;
+    devManager3.setReadBudget(1, 0);
+    mDevManager2.setReadBudget(1, 0);
+    mDevManager2.setDevice(0);
+    mDevice2.write(data2);
+    mDevice2.seek(0);
+    mOrder.clear();
+    connect(&mDevManager2, SIGNAL(received(QByteArray)),
+            this, SLOT(recordOrder(QByteArray)));
+    connect(&devManager3, SIGNAL(received(QByteArray)),
+            this, SLOT(recordOrder(QByteArray)));
+
+    mDevManager2.setDevice(&mDevice2);
+    devManager3.setDevice(&dev3);
+    QTest::qWait(50);
+    disconnect(&mDevManager2, SIGNAL(received(QByteArray)),
+               this, SLOT(recordOrder(QByteArray)));
+
+    QCOMPARE(mOrder, QStringList() << "a" << "b" << "a" << "b" << "a" << "b");
+}
+
+void DeviceManagerTests::testDatagram()
+{
+    QUdpSocket socket1, socket2;
+    QVERIFY(socket1.bind(QHostAddress::LocalHost, 0));
+    QVERIFY(socket2.bind(QHostAddress::LocalHost, 0));
+    socket1.connectToHost(QHostAddress::LocalHost, socket2.localPort());
+    socket2.connectToHost(QHostAddress::LocalHost, socket1.localPort());
+    qrs::internals::DeviceManager devManager1(&socket1, 0), devManager2(&socket2, 0);
+    QVERIFY(devManager1.isDatagram());
+    devManager1.setDatagramSize(64);
+    QSignalSpy spy(&devManager2, SIGNAL(received(QByteArray)));
+
+    // Messages sent at once share datagrams not exceeding the size
+    for (int i = 0; i < 5; i++) {
+        devManager1.send(QByteArray(20, 'a' + i));
+    }
+    // Message starting as a control frame is wrapped into a batch
+    devManager1.send(QByteArray(4, char(0xFF)));
+    devManager1.send(QByteArray(100, 'x'));
+    QTest::qWait(100);
+
+    QCOMPARE(spy.count(), 6);
+    for (int i = 0; i < 5; i++) {
+        QCOMPARE(spy[i][0].toByteArray(), QByteArray(20, 'a' + i));
+    }
+    QCOMPARE(spy[5][0].toByteArray(), QByteArray(4, char(0xFF)));
+    const qrs::DatagramStats &sent = devManager1.datagramStats();
+    QCOMPARE(sent.messagesSent, quint64(6));
+    QCOMPARE(sent.datagramsSent, quint64(3));
+    QCOMPARE(sent.sendDropped, quint64(1));
+    QVERIFY(sent.largestSent <= 64);
+    const qrs::DatagramStats &received = devManager2.datagramStats();
+    QCOMPARE(received.datagramsReceived, quint64(3));
+    QCOMPARE(received.messagesReceived, quint64(6));
+    QCOMPARE(received.bytesReceived, sent.bytesSent);
+
+    // Single message goes without prefix
+    spy.clear();
+    socket1.write("raw");
+    QTest::qWait(100);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy[0][0].toByteArray(), QByteArray("raw"));
+}
+
+void DeviceManagerTests::testBufferPool()
+{
+    qrs::internals::BufferPool pool;
+    QByteArray buf = pool.acquire(100);
+    QCOMPARE(buf.size(), 100);
+    QCOMPARE(pool.stats().misses, quint64(1));
+    pool.release(buf);
+    QVERIFY(buf.isNull());
+    QCOMPARE(pool.stats().recycled, quint64(1));
+    QCOMPARE(pool.stats().cachedBuffers, 1);
+
+    // Same size class
+    buf = pool.acquire(120);
+    QCOMPARE(buf.size(), 120);
+    QCOMPARE(pool.stats().hits, quint64(1));
+    QCOMPARE(pool.stats().cachedBuffers, 0);
+
+    // Array still referenced is not reused
+    QByteArray copy = buf;
+    pool.release(buf);
+    QCOMPARE(pool.stats().dropped, quint64(1));
+    QCOMPARE(pool.stats().cachedBuffers, 0);
+    QCOMPARE(copy.size(), 120);
+
+    // Too big to be pooled
+    buf = pool.acquire(qrs::internals::BufferPool::MAX_CLASS + 1);
+    pool.release(buf);
+    QCOMPARE(pool.stats().dropped, quint64(2));
+}
+
+void DeviceManagerTests::testFrameBufferReuse()
+{
+    // Receiver keeps no reference so the frame buffer is recycled
+    connect(&mDevManager2, SIGNAL(received(QByteArray)),
+            this, SLOT(recordOrder(const QByteArray &)));
+    mOrder.clear();
+    const qrs::BufferPoolStats before = qrs::internals::BufferPool::local()->stats();
+    // Longer than half of the smallest size class so Qt4 doesn't shrink them
+    const QString first = "first message of the frame buffer reuse test";
+    const QString second = "second message of the frame buffer reuse test";
+    mDevManager1.send(first.toLatin1());
+    mDevManager1.send(second.toLatin1());
+    sendDataToDev2(mDevice1.buffer());
+    disconnect(&mDevManager2, SIGNAL(received(QByteArray)),
+               this, SLOT(recordOrder(const QByteArray &)));
+    const qrs::BufferPoolStats after = qrs::internals::BufferPool::local()->stats();
+    QCOMPARE(mOrder, QStringList() << first << second);
+    QVERIFY(after.hits > before.hits);
+    QCOMPARE(after.recycled - before.recycled, quint64(2));
+}
+
+void DeviceManagerTests::testChannels()
+{
+    connect(&mDevManager2, SIGNAL(received(QByteArray)),
+            this, SLOT(recordChannel(const QByteArray &)));
+    mOrder.clear();
+    mDevManager1.send("a", 0);
+    mDevManager1.send("b", 3);
+    mDevManager1.send("c", 3);
+    mDevManager1.send("d");
+    // Channel is switched twice: 4 frames plus 2 selectors
+    QCOMPARE(mDevice1.buffer().size(), 4*5 + 2*4);
+    sendDataToDev2(mDevice1.buffer());
+    disconnect(&mDevManager2, SIGNAL(received(QByteArray)),
+               this, SLOT(recordChannel(const QByteArray &)));
+    QCOMPARE(mOrder, QStringList() << "0:a" << "3:b" << "3:c" << "0:d");
+}
+
 QTEST_MAIN(DeviceManagerTests)
 #include "devicemanagertests.moc"
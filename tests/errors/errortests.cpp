@@ -71,7 +71,8 @@ class ErrorTests: public QObject {
         void messageParsingError() {
             ErrorSignalSpy spy( mServerManager );
             mServerManager->setSerializer(jsonSerializer);
-            mServerManager->receive( QByteArray("I'm not JSON") );
+            qrs::Status status = mServerManager->receive( QByteArray("I'm not JSON") );
+            QCOMPARE( (int)status.code(), (int)qrs::Message::ProtocolError );
             QCOMPARE(spy.count , 1);
             QCOMPARE( spy.senders[0], mServerManager );
         }
@@ -105,7 +106,8 @@ class ErrorTests: public QObject {
             msg.params().insert("str","test");
             qrs::AbsMessageSerializer *serializer = mServerManager->serializer();
 
-            mServerManager->receive(serializer->serialize(msg));
+            qrs::Status status = mServerManager->receive(serializer->serialize(msg));
+            QCOMPARE( (int)status.code(), expectedErr );
             QCOMPARE( spy.count(), 1 );
             qrs::MessageAP err = serializer->deserialize( spy.first().at(0).toByteArray() );
             QVERIFY( err->type() == qrs::Message::Error );
@@ -144,6 +146,45 @@ class ErrorTests: public QObject {
             QCOMPARE( spy.count, 1 );
             QCOMPARE( (int)spy.types[0] , expectedErr );
         }
+        void validCallStatus() {
+            ErrorSignalSpy spy(mServerManager);
+            qrs::Message msg;
+            msg.setService("Example");
+            msg.setMethod("strMethod");
+            msg.params().insert("str","test");
+            qrs::AbsMessageSerializer *serializer = mServerManager->serializer();
+
+            qrs::Status status = mServerManager->receive(serializer->serialize(msg));
+            QVERIFY( status.isOk() );
+            QCOMPARE( spy.count, 0 );
+        }
+
+        void statusDetail() {
+            qrs::Status status(qrs::Message::IncorrectMethod,
+                               "Param \"%1\" of \"%2\"", "%2", "method");
+            QCOMPARE( status.detail(), QString("Param \"%2\" of \"method\"") );
+            status = qrs::Status(qrs::Message::ProtocolError, QString("ready"));
+            QCOMPARE( status.detail(), QString("ready") );
+            QVERIFY( qrs::Status().isOk() );
+            QVERIFY( qrs::Status().detail().isEmpty() );
+        }
+
+        void processMessageStatus() {
+            qrs::Message msg;
+            msg.setService("Example");
+            msg.setMethod("intMethod");
+            qrs::Status status;
+            mService->processMessage(msg, status);
+            QCOMPARE( (int)status.code(), (int)qrs::Message::IncorrectMethod );
+            QVERIFY( status.detail().contains("num") );
+            // Throwing version reports the same error
+            try {
+                mService->processMessage(msg);
+                QFAIL("IncorrectMethodException wasn't thrown");
+            } catch (const qrs::IncorrectMethodException &e) {
+                QCOMPARE( e.reason(), status.detail() );
+            }
+        }
     private:
         qrs::ServicesManager *mServerManager,*mClientManager;
         qrs::ExampleService *mService;
@@ -6,6 +6,7 @@
  * @date 10 Aug 2009
  */
 #include <QtCore/QObject>
+#include <QtCore/QBuffer>
 #include <QtTest/QtTest>
 
 #include <QRemoteSignal>
@@ -116,7 +117,76 @@ class RemoteSignalTests: public QObject {
          QCOMPARE(spy.first().at(0).toBool() , flag);
       }
 
+      /// Calls received from a device at once are delivered with one signal
+      void batchSignalTest() {
+         qrs::ServicesManager clientManager;
+         qrs::ExampleClient client(&clientManager);
+         QSignalSpy sent(&clientManager, SIGNAL(send(QByteArray)));
+         client.batchMethod("one", 1);
+         client.batchMethod("two", 2);
+         client.batchMethod("three", 3);
+         QCOMPARE(sent.count(), 3);
+
+         QBuffer dev;
+         dev.open(QIODevice::ReadWrite);
+         {
+            // QByteArray serialization is the same as message frame
+            QDataStream stream(&dev);
+            for (int i = 0; i < sent.count(); i++) {
+               stream << sent[i].at(0).toByteArray();
+            }
+         }
+         dev.seek(0);
+
+         qrs::ServicesManager serverManager;
+         qrs::ExampleService service(&serverManager);
+         QSignalSpy single(&service, SIGNAL(batchMethod(QString,int)));
+         mBatches.clear();
+         connect(&service, SIGNAL(batchMethodBatch(QList<qrs::ExampleService::BatchMethodArgs>)),
+                 this, SLOT(onBatch(QList<qrs::ExampleService::BatchMethodArgs>)));
+         serverManager.addDevice(&dev);
+
+         QCOMPARE(single.count(), 0);
+         QCOMPARE(mBatches.size(), 1);
+         QCOMPARE(mBatches[0].size(), 3);
+         QCOMPARE(mBatches[0][0].str, QString("one"));
+         QCOMPARE(mBatches[0][2].num, 3);
+      }
+
+      /// Params of the signal nobody is connected to are never decoded
+      void lazyParamsTest() {
+         qrs::ServicesManager clientManager;
+         qrs::ExampleClient client(&clientManager);
+         qrs::Message call;
+         call.setService("Example");
+         call.setMethod("boolSignal");
+         call.params().insert("flag", qrs::createArg(true));
+         const QByteArray raw = qDataStreamSerializer->serialize(call);
+
+         qrs::Status status;
+         qrs::MessageAP msg = qDataStreamSerializer->deserialize(raw, status);
+         QVERIFY(status.isOk());
+         QVERIFY(!msg->paramsDecoded());
+         client.processMessage(*msg, status);
+         QVERIFY(status.isOk());
+         QVERIFY(!msg->paramsDecoded());
+
+         QSignalSpy spy(&client, SIGNAL(boolSignal(bool)));
+         msg = qDataStreamSerializer->deserialize(raw, status);
+         client.processMessage(*msg, status);
+         QVERIFY(status.isOk());
+         QVERIFY(msg->paramsDecoded());
+         QCOMPARE(spy.count(), 1);
+         QCOMPARE(spy.first().at(0).toBool(), true);
+      }
+
+   public slots:
+      void onBatch(const QList<qrs::ExampleService::BatchMethodArgs> &batch) {
+         mBatches.append(batch);
+      }
+
    private:
+      QList< QList<qrs::ExampleService::BatchMethodArgs> > mBatches;
       qrs::ServicesManager *mServerManager,*mClientManager;
       qrs::ExampleClient *mClient;
       qrs::ExampleService *mService;
@@ -0,0 +1,21 @@
+/**
+ * @file composite.cpp
+ * @brief Entry point for CompositeSerializer tests
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include <QtTest/QtTest>
+
+#include "serializerstestsuit.h"
+#include "compositeserializer.h"
+
+int main(int argc, char** argv) {
+   SerializersTestSuit testsuit(compositeSerializer);
+
+   testsuit.addDeserializationErrorTestCase("UnknownFormat",(QByteArray)"12345");
+   testsuit.addDeserializationErrorTestCase("Empty",QByteArray());
+   testsuit.addDeserializationErrorTestCase("EmptyJson",(QByteArray)" {}");
+
+   return QTest::qExec(&testsuit,argc,argv);
+}
@@ -716,6 +716,26 @@ void SerializersTestSuit::testSerialization() {
    }
 }
 
+void SerializersTestSuit::testSerializeAt() {
+   QFETCH(QString,key);
+
+   try {
+      const int offset = 4;
+      QByteArray raw = mSerializer->serialize( *mMessages.value(key) );
+      QByteArray res = mSerializer->serializeAt( *mMessages.value(key), offset );
+      QCOMPARE(res.size() , offset + raw.size());
+      QCOMPARE(res.mid(offset) , raw);
+   } catch(const qrs::UnsupportedTypeException& e) {
+      qWarning("Unsupported type");
+      QFAIL( e.what() );
+   } catch(const std::exception& e) {
+      qWarning("std::exception");
+      QFAIL( e.what() );
+   } catch( ... ) {
+      QFAIL("Exception of unknown type");
+   }
+}
+
 void SerializersTestSuit::testDeserializationError_data() {
    QTest::addColumn<QByteArray>("rawMsg");
 
@@ -744,3 +764,32 @@ void SerializersTestSuit::testDeserializationError() {
       QFAIL("Caught exception of unknown type");
    }
 }
+
+void SerializersTestSuit::testDeserializationStatus() {
+   QFETCH(QByteArray,rawMsg);
+
+   qrs::Status status;
+   qrs::MessageAP res = mSerializer->deserialize(rawMsg, status);
+   QVERIFY(res.get() == 0);
+   QVERIFY(!status.isOk());
+   QVERIFY(!status.detail().isEmpty());
+}
+
+/**
+ * Serializer may leave params to be decoded later. Truncated params map
+ * must be either rejected by the serializer or reported as corrupted.
+ */
+void SerializersTestSuit::testTruncatedParams() {
+   QByteArray raw = mSerializer->serialize( *mMessages.value("Two args") );
+   raw.chop(3);
+
+   qrs::Status status;
+   qrs::MessageAP res = mSerializer->deserialize(raw, status);
+   if ( res.get() == 0 ) {
+      QVERIFY(!status.isOk());
+      return;
+   }
+   QVERIFY(status.isOk());
+   QVERIFY(res->paramsCorrupted());
+   QVERIFY(res->params().isEmpty());
+}
@@ -31,6 +31,8 @@ class SerializersTestSuit:public QObject{
 
       void testSerialization_data();
       void testSerialization();
+      void testSerializeAt_data() {testSerialization_data();}
+      void testSerializeAt();
 
       void testQCharSerialization_data();
       void testQCharSerialization();
@@ -82,6 +84,9 @@ class SerializersTestSuit:public QObject{
 
       void testDeserializationError_data();
       void testDeserializationError();
+      void testDeserializationStatus_data() {testDeserializationError_data();}
+      void testDeserializationStatus();
+      void testTruncatedParams();
    private:
       Q_DISABLE_COPY(SerializersTestSuit);
 
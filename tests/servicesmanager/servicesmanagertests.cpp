@@ -16,6 +16,18 @@
 
 Q_DECLARE_METATYPE(QIODevice *);
 
+/// Remembers the thread its slot was called in
+class ThreadProbe: public QObject {
+Q_OBJECT
+public:
+    ThreadProbe(): mThread(0) {}
+    QThread *calledIn() const {return mThread;}
+public slots:
+    void record() {mThread = QThread::currentThread();}
+private:
+    QThread *volatile mThread;
+};
+
 class ServicesManagerTests:public QObject {
 Q_OBJECT
 private slots:
@@ -177,6 +189,29 @@ private slots:
         QCOMPARE(spy.first().first().value<QIODevice *>(), &dev1);
     }
 
+    void testPeerTimeout() {
+        QBuffer dev1;
+        QBuffer dev2;
+        QSignalSpy spy(mManager, SIGNAL(peerTimeout(QIODevice *)));
+
+        dev1.open(QIODevice::ReadWrite);
+        dev2.open(QIODevice::ReadWrite);
+        mManager->setKeepAlive(0, 600);
+        QCOMPARE(mManager->keepAliveTimeout(), 600);
+        mManager->addDevice(&dev1);
+        mManager->addDevice(&dev2);
+
+        // Only dev2 receives messages
+        QTest::qWait(300);
+        sendMsgToDev(&dev2, mRawMsg);
+        QTest::qWait(450);
+        QCOMPARE(spy.count() , 1);
+        QCOMPARE(spy.first().first().value<QIODevice *>(), &dev1);
+        QVERIFY(!dev1.isOpen());
+        QCOMPARE(mManager->devicesCount(), 1);
+        QCOMPARE(mManager->deviceAt(0), &dev2);
+    }
+
     void testUsingManyDevices() {
         QBuffer dev1;
         QBuffer dev2;
@@ -202,6 +237,194 @@ private slots:
         QCOMPARE(spy.count() , 2);
     }
 
+    void testGroups() {
+        QBuffer dev1;
+        QBuffer dev2;
+        QBuffer dev3;
+
+        dev1.open(QIODevice::ReadWrite);
+        dev2.open(QIODevice::ReadWrite);
+        dev3.open(QIODevice::ReadWrite);
+        mManager->addDevice(&dev1);
+        mManager->addDevice(&dev2);
+        mManager->addDevice(&dev3);
+        mManager->joinGroup("flags", &dev1);
+        mManager->joinGroup("flags", &dev2);
+        mManager->joinGroup("flags", &dev2);
+        QCOMPARE(mManager->groupSize("flags"), 2);
+        QVERIFY(mManager->isGroupMember("flags", &dev1));
+        QVERIFY(!mManager->isGroupMember("flags", &dev3));
+
+        // Only group members receive routed signal
+        mManager->setSignalGroup("Example", "boolSignal", "flags");
+        QCOMPARE(mManager->signalGroup("Example", "boolSignal"), QString("flags"));
+        mService->boolSignal(true);
+        QVERIFY( !dev1.data().isEmpty() );
+        QCOMPARE(dev1.data(), dev2.data());
+        QVERIFY( dev3.data().isEmpty() );
+
+        mManager->leaveGroup("flags", &dev1);
+        QCOMPARE(mManager->groupSize("flags"), 1);
+        mManager->removeDevice(1);
+        QCOMPARE(mManager->groupSize("flags"), 0);
+
+        // Restoring broadcast
+        mManager->setSignalGroup("Example", "boolSignal", QString());
+        mService->boolSignal(false);
+        QVERIFY( !dev3.data().isEmpty() );
+    }
+
+    void testCompositeSerializer() {
+        QBuffer jsonDev;
+        QBuffer binaryDev;
+        QSignalSpy spy(mService,SIGNAL(voidMethod()));
+
+        jsonDev.open(QIODevice::ReadWrite);
+        binaryDev.open(QIODevice::ReadWrite);
+        mManager->setSerializer(compositeSerializer);
+        mManager->addDevice(&jsonDev);
+        mManager->addDevice(&binaryDev);
+
+        qrs::Message call;
+        call.setType(qrs::Message::RemoteCall);
+        call.setService("Example");
+        call.setMethod("voidMethod");
+        QByteArray jsonFrame;
+        {
+            QDataStream stream(&jsonFrame, QIODevice::WriteOnly);
+            stream << jsonSerializer->serialize(call);
+        }
+        sendMsgToDev(&jsonDev, jsonFrame);
+        sendMsgToDev(&binaryDev, mRawMsg);
+        QCOMPARE(spy.count(), 2);
+        QCOMPARE(mManager->deviceSerializer(&jsonDev), jsonSerializer);
+        QCOMPARE(mManager->deviceSerializer(&binaryDev), qDataStreamSerializer_4_5);
+
+        // Each peer gets signals in its own format. Frame size goes first.
+        const int jsonPos = jsonDev.data().size();
+        const int binaryPos = binaryDev.data().size();
+        mService->boolSignal(true);
+        QVERIFY(jsonSerializer->recognizes(jsonDev.data().mid(jsonPos + 4)));
+        QVERIFY(qDataStreamSerializer_4_5->recognizes(binaryDev.data().mid(binaryPos + 4)));
+    }
+
+    void testChannels() {
+        QBuffer clientDev;
+        clientDev.open(QIODevice::ReadWrite);
+        qrs::ServicesManager clientManager1, clientManager2;
+        qrs::ExampleClient *client1 = new qrs::ExampleClient(&clientManager1);
+        qrs::ExampleClient *client2 = new qrs::ExampleClient(&clientManager2);
+        QVERIFY( clientManager1.addChannel(&clientDev, 1) );
+        QVERIFY( clientManager2.addChannel(&clientDev, 2) );
+        QVERIFY( !clientManager2.addChannel(&clientDev, 3) );
+        QBuffer other;
+        QVERIFY( !clientManager1.addChannel(&other, 240) );
+        client1->strMethod("one");
+        client2->strMethod("two");
+        client1->strMethod("three");
+
+        QBuffer serverDev;
+        serverDev.open(QIODevice::ReadWrite);
+        qrs::ServicesManager serverManager1, serverManager2;
+        qrs::ExampleService *service1 = new qrs::ExampleService(&serverManager1);
+        qrs::ExampleService *service2 = new qrs::ExampleService(&serverManager2);
+        QSignalSpy spy1(service1, SIGNAL(strMethod(QString)));
+        QSignalSpy spy2(service2, SIGNAL(strMethod(QString)));
+        QVERIFY( serverManager1.addChannel(&serverDev, 1) );
+        QVERIFY( serverManager2.addChannel(&serverDev, 2) );
+        sendMsgToDev(&serverDev, clientDev.data());
+        QCOMPARE( spy1.count(), 2 );
+        QCOMPARE( spy1[0][0].toString(), QString("one") );
+        QCOMPARE( spy1[1][0].toString(), QString("three") );
+        QCOMPARE( spy2.count(), 1 );
+        QCOMPARE( spy2[0][0].toString(), QString("two") );
+
+        // Device manager is kept while any manager uses the device
+        serverManager1.removeDevice(0);
+        sendMsgToDev(&serverDev, clientDev.data());
+        QCOMPARE( spy1.count(), 2 );
+        QCOMPARE( spy2.count(), 2 );
+    }
+
+    void testLoopback() {
+        qrs::ServicesManager clientManager;
+        qrs::ExampleClient *client = new qrs::ExampleClient(&clientManager);
+        QSignalSpy callSpy(mService, SIGNAL(strMethod(QString)));
+        QSignalSpy signalSpy(client, SIGNAL(boolSignal(bool)));
+        QSignalSpy rawSpy(&clientManager, SIGNAL(send(QByteArray)));
+        QVERIFY( !clientManager.hasConsumers() );
+        clientManager.setLoopbackPeer(mManager);
+        QCOMPARE( mManager->loopbackPeer(), &clientManager );
+        QVERIFY( clientManager.hasConsumers() );
+
+        // Nothing is serialized
+        clientManager.setSerializer(0);
+        client->strMethod("direct");
+        QCOMPARE( callSpy.count(), 1 );
+        QCOMPARE( callSpy[0][0].toString(), QString("direct") );
+        mService->boolSignal(true);
+        QCOMPARE( signalSpy.count(), 1 );
+        QCOMPARE( signalSpy[0][0].toBool(), true );
+        QCOMPARE( rawSpy.count(), 0 );
+
+        clientManager.setSerializer(qDataStreamSerializer);
+        clientManager.setLoopbackSerialization(true);
+        client->strMethod("serialized");
+        QCOMPARE( callSpy.count(), 2 );
+        QCOMPARE( callSpy[1][0].toString(), QString("serialized") );
+        QCOMPARE( rawSpy.count(), 1 );
+
+        // Peer forgets the link of the deleted manager
+        qrs::ServicesManager *other = new qrs::ServicesManager;
+        other->setLoopbackPeer(mManager);
+        QCOMPARE( clientManager.loopbackPeer(), (qrs::ServicesManager*)0 );
+        delete other;
+        QCOMPARE( mManager->loopbackPeer(), (qrs::ServicesManager*)0 );
+        mService->boolSignal(false);
+        QCOMPARE( signalSpy.count(), 1 );
+    }
+
+    void testSubscriptionFilters() {
+        qrs::Message msg;
+        msg.setService("Example");
+        msg.setMethod("qrs.subscribe");
+        QVariantMap params;
+        params["signal"] = QString("boolSignal");
+        QVariantMap filter;
+        filter["flag"] = true;
+        params["filter"] = filter;
+        msg.setParams(params);
+
+        // There is no peer to filter signals for
+        qrs::Status status = mManager->receive(qDataStreamSerializer_4_5->serialize(msg));
+        QCOMPARE(status.code(), qrs::Message::IncorrectMethod);
+
+        QBuffer dev;
+        dev.open(QIODevice::ReadWrite);
+        mManager->addDevice(&dev);
+        // Repeated filter doesn't count against the limit
+        QByteArray frames;
+        QDataStream stream(&frames, QIODevice::WriteOnly);
+        for ( int i = 0; i < 32; i++ ) {
+            filter["flag"] = i;
+            params["filter"] = filter;
+            msg.setParams(params);
+            stream << qDataStreamSerializer_4_5->serialize(msg);
+            stream << qDataStreamSerializer_4_5->serialize(msg);
+        }
+        sendMsgToDev(&dev, frames);
+        QCOMPARE(dev.data().size(), frames.size());
+
+        filter["flag"] = 32;
+        params["filter"] = filter;
+        msg.setParams(params);
+        QByteArray extra;
+        QDataStream extraStream(&extra, QIODevice::WriteOnly);
+        extraStream << qDataStreamSerializer_4_5->serialize(msg);
+        sendMsgToDev(&dev, extra);
+        QVERIFY(dev.data().size() > frames.size() + extra.size());
+    }
+
     void testSendWithoutSerializer() {
         QBuffer dev;
         dev.open(QIODevice::ReadWrite);
@@ -213,6 +436,22 @@ private slots:
         QVERIFY( dev.data().isEmpty() );
     }
 
+    void testHasConsumers() {
+        QVERIFY( !mManager->hasConsumers() );
+        {
+            QSignalSpy spy(mManager, SIGNAL(send(QByteArray)));
+            QVERIFY( mManager->hasConsumers() );
+            mService->boolSignal(true);
+            QCOMPARE( spy.count(), 1 );
+        }
+        QBuffer dev;
+        dev.open(QIODevice::ReadWrite);
+        mManager->addDevice(&dev);
+        QVERIFY( mManager->hasConsumers() );
+        mManager->setSerializer(0);
+        QVERIFY( !mManager->hasConsumers() );
+    }
+
     void testReceiveWithoutSerializer() {
         QBuffer dev;
         dev.open(QIODevice::ReadWrite);
@@ -242,6 +481,67 @@ private slots:
         sendMsgToDev(&dev, mRawMsg );
         QCOMPARE(spy.count() , 1);
     }
+
+    void testRecordReplay() {
+        const QString path = QDir::temp().absoluteFilePath("qrs_traffic_test.rec");
+        QFile::remove(path);
+        qrs::TrafficRecorder recorder(path);
+        QVERIFY(recorder.open());
+        mManager->setRecorder(&recorder);
+
+        QSignalSpy spy(mService,SIGNAL(voidMethod()));
+        QBuffer dev;
+        dev.open(QIODevice::ReadWrite);
+        dev.write(mRawMsg);
+        dev.write(mRawMsg);
+        dev.seek(0);
+        mManager->addDevice(&dev);
+        QCOMPARE(spy.count() , 2);
+        QVERIFY(mManager->deviceId(&dev) != 0);
+        mManager->setRecorder(0);
+        recorder.close();
+
+        qrs::TrafficReplay replay(path);
+        QVERIFY(replay.open());
+        qrs::ReplayStats stats = replay.replay(mManager, 0);
+        QCOMPARE(spy.count() , 4);
+        QCOMPARE(stats.messages, quint64(2));
+        QCOMPARE(stats.errors, quint64(0));
+        QVERIFY(stats.maxLatency >= stats.p99Latency);
+
+        // Messages of other devices are skipped
+        stats = replay.replay(mManager, 10.0, mManager->deviceId(&dev) + 1);
+        QCOMPARE(stats.messages, quint64(0));
+        QCOMPARE(spy.count() , 4);
+        replay.close();
+        QFile::remove(path);
+    }
+    void testThreadDispatch() {
+        QThread thread;
+        thread.start();
+        qrs::ExampleService *service = new qrs::ExampleService;
+        mManager->registerService(service);
+        service->moveToThread(&thread);
+        ThreadProbe probe;
+        connect(service, SIGNAL(voidMethod()),
+                &probe, SLOT(record()), Qt::DirectConnection);
+        mManager->setThreadDispatch(true);
+
+        QBuffer dev;
+        dev.open(QIODevice::ReadWrite);
+        mManager->addDevice(&dev);
+        sendMsgToDev(&dev, mRawMsg);
+        for (int i = 0; i < 100 && probe.calledIn() == 0; i++) {
+            QTest::qWait(10);
+        }
+        // Service emits its signal in its own thread
+        QCOMPARE(probe.calledIn(), &thread);
+
+        mManager->unregister(service);
+        thread.quit();
+        thread.wait();
+        delete service;
+    }
 private:
     qrs::ServicesManager *mManager;
     qrs::ExampleService *mService;
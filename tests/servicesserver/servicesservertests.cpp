@@ -0,0 +1,231 @@
+/**
+ * @file servicesservertests.cpp
+ * @brief ServicesServer class tests
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include <QtTest/QtTest>
+#include <QtCore/QObject>
+#include <QtNetwork/QTcpSocket>
+
+#include <QRemoteSignal>
+
+#include "exampleservice.h"
+#include "exampleclient.h"
+
+class ServicesServerTests:public QObject {
+Q_OBJECT
+private slots:
+
+    void init() {
+        mManager = new qrs::ServicesManager;
+        mService = new qrs::ExampleService(mManager);
+        mServer = new qrs::ServicesServer(mManager);
+        QVERIFY(mServer->listen(QHostAddress::LocalHost));
+    }
+
+    void cleanup() {
+        delete mServer;
+        delete mManager;
+    }
+
+    void testAcceptAndReclaim() {
+        QTcpSocket client;
+        client.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QVERIFY(client.waitForConnected(1000));
+        QTest::qWait(100);
+        QCOMPARE(mServer->acceptedCount(), quint64(1));
+        QCOMPARE(mServer->connectionsCount(), 1);
+        QCOMPARE(mManager->devicesCount(), 1);
+
+        // Socket should be deleted and removed from the manager without
+        // any polling
+        client.disconnectFromHost();
+        QTest::qWait(100);
+        QCOMPARE(mServer->connectionsCount(), 0);
+        QCOMPARE(mManager->devicesCount(), 0);
+    }
+
+    void testRemoteCall() {
+        QSignalSpy spy(mService, SIGNAL(voidMethod()));
+        QTcpSocket socket;
+        qrs::ServicesManager clientManager;
+        qrs::ExampleClient *client = new qrs::ExampleClient(&clientManager);
+
+        socket.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QVERIFY(socket.waitForConnected(1000));
+        clientManager.addDevice(&socket);
+        client->voidMethod();
+        QTest::qWait(100);
+        QCOMPARE(spy.count(), 1);
+    }
+
+    void testProtocolNegotiation() {
+        // Server keeps JSON for the clients which can't negotiate
+        mManager->setSerializer(jsonSerializer);
+        QSignalSpy serverSpy(mService, SIGNAL(voidMethod()));
+
+        QTcpSocket oldSocket;
+        qrs::ServicesManager oldManager;
+        oldManager.setSerializer(jsonSerializer);
+        qrs::ExampleClient *oldClient = new qrs::ExampleClient(&oldManager);
+        QSignalSpy oldSpy(oldClient, SIGNAL(boolSignal(bool)));
+
+        QTcpSocket newSocket;
+        qrs::ServicesManager newManager;
+        newManager.setSerializer(jsonSerializer);
+        newManager.setProtocolNegotiation(true);
+        QVERIFY(newManager.protocolNegotiation());
+        qrs::ExampleClient *newClient = new qrs::ExampleClient(&newManager);
+        QSignalSpy newSpy(newClient, SIGNAL(boolSignal(bool)));
+        QSignalSpy negotiatedSpy(&newManager,
+            SIGNAL(protocolNegotiated(QIODevice *, qrs::AbsMessageSerializer *)));
+
+        oldSocket.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        newSocket.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QVERIFY(oldSocket.waitForConnected(1000));
+        QVERIFY(newSocket.waitForConnected(1000));
+        oldManager.addDevice(&oldSocket);
+        newManager.addDevice(&newSocket);
+        // Sent before negotiation is finished
+        newClient->voidMethod();
+        QTest::qWait(100);
+
+        QCOMPARE(negotiatedSpy.count(), 1);
+        QCOMPARE(newManager.deviceSerializer(&newSocket),
+                 qDataStreamSerializer_4_5);
+        QCOMPARE(oldManager.deviceSerializer(&oldSocket), jsonSerializer);
+        QCOMPARE(serverSpy.count(), 1);
+
+        // Each client gets the signal in its own format
+        newClient->voidMethod();
+        oldClient->voidMethod();
+        mService->boolSignal(true);
+        QTest::qWait(100);
+        QCOMPARE(serverSpy.count(), 3);
+        QCOMPARE(oldSpy.count(), 1);
+        QCOMPARE(newSpy.count(), 1);
+    }
+
+    void testBothSidesNegotiate() {
+        // Preferences differ so answering each other's offers would make
+        // the peers select different formats
+        mManager->setProtocolNegotiation(true);
+        mManager->setSupportedSerializers(QList<qrs::AbsMessageSerializer*>()
+                                          << jsonSerializer
+                                          << qDataStreamSerializer_4_5);
+        QSignalSpy serverSpy(mService, SIGNAL(voidMethod()));
+
+        QTcpSocket socket;
+        qrs::ServicesManager clientManager;
+        clientManager.setProtocolNegotiation(true);
+        clientManager.setSupportedSerializers(QList<qrs::AbsMessageSerializer*>()
+                                              << qDataStreamSerializer_4_5
+                                              << jsonSerializer);
+        qrs::ExampleClient *client = new qrs::ExampleClient(&clientManager);
+        QSignalSpy spy(client, SIGNAL(boolSignal(bool)));
+
+        socket.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QVERIFY(socket.waitForConnected(1000));
+        clientManager.addDevice(&socket);
+        QTest::qWait(100);
+
+        QCOMPARE(mManager->devicesCount(), 1);
+        QCOMPARE(clientManager.deviceSerializer(&socket),
+                 mManager->deviceSerializer(mManager->deviceAt(0)));
+        client->voidMethod();
+        mService->boolSignal(true);
+        QTest::qWait(100);
+        QCOMPARE(serverSpy.count(), 1);
+        QCOMPARE(spy.count(), 1);
+    }
+
+    void testSubscriptions() {
+        QSignalSpy serverSpy(mService, SIGNAL(voidMethod()));
+        QTcpSocket socket;
+        qrs::ServicesManager clientManager;
+        qrs::ExampleClient *client = new qrs::ExampleClient(&clientManager);
+        QSignalSpy spy(client, SIGNAL(boolSignal(bool)));
+
+        socket.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QVERIFY(socket.waitForConnected(1000));
+        clientManager.addDevice(&socket);
+        QTest::qWait(100);
+
+        // Not subscribed client gets everything
+        mService->boolSignal(false);
+        QTest::qWait(100);
+        QCOMPARE(spy.count(), 1);
+
+        client->subscribeBoolSignalByFlag(true);
+        QTest::qWait(100);
+        QCOMPARE(serverSpy.count(), 0);
+        mService->boolSignal(false);
+        mService->boolSignal(true);
+        QTest::qWait(100);
+        QCOMPARE(spy.count(), 2);
+        QCOMPARE(spy.last().first().toBool(), true);
+
+        client->unsubscribeBoolSignal();
+        QTest::qWait(100);
+        mService->boolSignal(true);
+        QTest::qWait(100);
+        QCOMPARE(spy.count(), 2);
+    }
+
+    void testMaxConnections() {
+        QSignalSpy spy(mServer, SIGNAL(connectionRejected()));
+        mServer->setMaxConnections(1);
+        QCOMPARE(mServer->maxConnections(), 1);
+
+        QTcpSocket client1;
+        QTcpSocket client2;
+        client1.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QVERIFY(client1.waitForConnected(1000));
+        QTest::qWait(100);
+        client2.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QTest::qWait(100);
+
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(mServer->rejectedCount(), quint64(1));
+        QCOMPARE(mServer->connectionsCount(), 1);
+        QCOMPARE(client2.state(), QAbstractSocket::UnconnectedState);
+        QCOMPARE(client1.state(), QAbstractSocket::ConnectedState);
+    }
+
+    void testSharding() {
+        qrs::ServicesManager secondManager;
+        mServer->addManager(&secondManager);
+        QCOMPARE(mServer->managersCount(), 2);
+
+        QTcpSocket client1;
+        QTcpSocket client2;
+        client1.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        client2.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QVERIFY(client1.waitForConnected(1000));
+        QVERIFY(client2.waitForConnected(1000));
+        QTest::qWait(100);
+
+        QCOMPARE(mServer->connectionsCount(), 2);
+        QCOMPARE(mManager->devicesCount(), 1);
+        QCOMPARE(secondManager.devicesCount(), 1);
+    }
+
+    void testAcceptRate() {
+        QTcpSocket client;
+        client.connectToHost(QHostAddress::LocalHost, mServer->serverPort());
+        QVERIFY(client.waitForConnected(1000));
+        QTest::qWait(1100);
+        QCOMPARE(mServer->acceptRate(), 1);
+    }
+
+private:
+    qrs::ServicesManager *mManager;
+    qrs::ExampleService *mService;
+    qrs::ServicesServer *mServer;
+};
+
+QTEST_MAIN(ServicesServerTests);
+
+#include "servicesservertests.moc"
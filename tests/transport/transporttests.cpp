@@ -0,0 +1,202 @@
+/**
+ * @file transporttests.cpp
+ * @brief AbsTransport tests
+ *
+ * @author agent agent@local
+ * @date 19 Oct 2026
+ */
+#include <QtCore/QObject>
+#include <QtCore/QByteArray>
+#include <QtCore/QtEndian>
+#include <QtTest/QtTest>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+#include "QRemoteSignal"
+#include "devicemanager.h"
+
+using qrs::internals::DeviceManager;
+
+namespace {
+
+    /**
+     * Scrambles the message with the key byte and appends its checksum
+     * mixed with the key so frames of the peer with other key are
+     * rejected. Protects nothing, only exercises the hook.
+     */
+    class ScrambleTransport: public qrs::AbsTransport
+    {
+    public:
+        explicit ScrambleTransport(quint8 key): mKey(key) {}
+
+        virtual int overhead() const {return sizeof(quint32);}
+
+        virtual bool seal(const char *data, int size, char *out)
+        {
+            for (int i = 0; i < size; i++) {
+                out[i] = char(data[i] ^ mKey);
+            }
+            qToBigEndian<quint32>(qChecksum(data, size) ^ mKey,
+                                  reinterpret_cast<uchar*>(out + size));
+            return true;
+        }
+
+        virtual int open(char *frame, int size)
+        {
+            const int msgSize = size - overhead();
+            if (msgSize < 0) {
+                return -1;
+            }
+            for (int i = 0; i < msgSize; i++) {
+                frame[i] = char(frame[i] ^ mKey);
+            }
+            const quint32 sum = qFromBigEndian<quint32>(
+                    reinterpret_cast<const uchar*>(frame + msgSize));
+            if (sum != (qChecksum(frame, msgSize) ^ mKey)) {
+                return -1;
+            }
+            return msgSize;
+        }
+
+    private:
+        quint8 mKey;
+    };
+
+}
+
+class TransportTests: public QObject
+{
+Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void testLoopback();
+    void testLoopbackForgedFrame();
+    void testThroughput_data();
+    void testThroughput();
+
+private:
+    QTcpServer mServer;
+    QTcpSocket *mClient;
+    QTcpSocket *mAccepted;
+
+    void connectLoopback();
+};
+
+void TransportTests::initTestCase()
+{
+    qRegisterMetaType<qrs::internals::DeviceManager *>("qrs::internals::DeviceManager*");
+    QVERIFY(mServer.listen(QHostAddress::LocalHost));
+    mClient = 0;
+    mAccepted = 0;
+}
+
+void TransportTests::cleanup()
+{
+    delete mClient;
+    mClient = 0;
+    delete mAccepted;
+    mAccepted = 0;
+}
+
+void TransportTests::connectLoopback()
+{
+    mClient = new QTcpSocket;
+    mClient->connectToHost(QHostAddress::LocalHost, mServer.serverPort());
+    QVERIFY(mClient->waitForConnected(1000));
+    QVERIFY(mServer.waitForNewConnection(1000));
+    mAccepted = mServer.nextPendingConnection();
+    QVERIFY(mAccepted != 0);
+    // Deleted by cleanup
+    mAccepted->setParent(0);
+}
+
+/// RFC 8439 section 2.4.2
+void TransportTests::testLoopback()
+{
+    connectLoopback();
+    DeviceManager client(mClient, 0), server(mAccepted, 0);
+    client.setTransport(new ScrambleTransport(7));
+    server.setTransport(new ScrambleTransport(7));
+    QSignalSpy serverSpy(&server, SIGNAL(received(QByteArray)));
+    QSignalSpy clientSpy(&client, SIGNAL(received(QByteArray)));
+    QSignalSpy errorSpy(&server, SIGNAL(transportError(qrs::internals::DeviceManager*)));
+
+    for (int i = 0; i < 10; i++) {
+        client.send(QByteArray(100*i, 'a' + i));
+    }
+    server.send("reply");
+    // Control frames go as is and still work
+    client.sendControlFrame(DeviceManager::PingFrame);
+    QTest::qWait(200);
+
+    QCOMPARE(errorSpy.count(), 0);
+    QCOMPARE(serverSpy.count(), 10);
+    for (int i = 0; i < 10; i++) {
+        QCOMPARE(serverSpy[i][0].toByteArray(), QByteArray(100*i, 'a' + i));
+    }
+    QCOMPARE(clientSpy.count(), 1);
+    QCOMPARE(clientSpy[0][0].toByteArray(), QByteArray("reply"));
+}
+
+void TransportTests::testLoopbackForgedFrame()
+{
+    connectLoopback();
+    DeviceManager client(mClient, 0), server(mAccepted, 0);
+    client.setTransport(new ScrambleTransport(1));
+    server.setTransport(new ScrambleTransport(2));
+    QSignalSpy serverSpy(&server, SIGNAL(received(QByteArray)));
+    QSignalSpy errorSpy(&server, SIGNAL(transportError(qrs::internals::DeviceManager*)));
+
+    client.send("Hi");
+    QTest::qWait(200);
+    QCOMPARE(serverSpy.count(), 0);
+    QCOMPARE(errorSpy.count(), 1);
+}
+
+void TransportTests::testThroughput_data()
+{
+    QTest::addColumn<bool>("protect");
+    QTest::addColumn<int>("size");
+
+    QTest::newRow("plain 64") << false << 64;
+    QTest::newRow("scrambled 64") << true << 64;
+    QTest::newRow("plain 4096") << false << 4096;
+    QTest::newRow("scrambled 4096") << true << 4096;
+}
+
+/**
+ * Compare the results of plain and scrambled rows to see the overhead of
+ * the transport hook over local sockets.
+ */
+void TransportTests::testThroughput()
+{
+    QFETCH(bool, protect);
+    QFETCH(int, size);
+    const int count = 1000;
+
+    connectLoopback();
+    DeviceManager client(mClient, 0), server(mAccepted, 0);
+    if (protect) {
+        client.setTransport(new ScrambleTransport(7));
+        server.setTransport(new ScrambleTransport(7));
+    }
+    QSignalSpy spy(&server, SIGNAL(received(QByteArray)));
+    const QByteArray msg(size, 'x');
+
+    QBENCHMARK {
+        spy.clear();
+        for (int i = 0; i < count; i++) {
+            client.send(msg);
+        }
+        while (spy.count() < count) {
+            mClient->flush();
+            QVERIFY(mAccepted->waitForReadyRead(1000));
+        }
+    }
+    QCOMPARE(spy.last()[0].toByteArray(), msg);
+}
+
+QTEST_MAIN(TransportTests)
+#include "transporttests.moc"